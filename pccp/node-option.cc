@@ -1,7 +1,11 @@
 /*------------------------- my changes starts ---------------------------*/
 
 #include "node-option.h"
+#include "ns3/node.h"
 #include "ns3/log.h"
+#include "ns3/type-id.h"
+#include "ns3/double.h"
+#include <cmath>
 
 namespace ns3 {
 
@@ -20,7 +24,9 @@ NodeOption::NodeOption()
   m_gp (0),
   m_svc (0.0),
   m_Offsprings (0),
-  m_parentDegree (0)
+  m_parentDegree (0),
+  m_pathDegree (0),
+  m_idle (false)
 {
 
 }
@@ -34,6 +40,26 @@ TypeId NodeOption::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("Internet")
     .AddConstructor<NodeOption> ()
+    .AddAttribute ("Estimator",
+                   "Type of the estimators smoothing the Ta and Ts samples",
+                   TypeIdValue (PccpEwmaEstimator::GetTypeId ()),
+                   MakeTypeIdAccessor (&NodeOption::m_estimatorType),
+                   MakeTypeIdChecker ())
+    .AddAttribute ("InitialTa",
+                   "Mean packet inter-arrival time before the first sample, in seconds",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&NodeOption::m_initialTa),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("InitialTs",
+                   "Mean packet service time before the first sample, in seconds",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&NodeOption::m_initialTs),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("InitialSvc",
+                   "Scheduling rate before the first congestion, in packets per second",
+                   DoubleValue (100),
+                   MakeDoubleAccessor (&NodeOption::m_initialSvc),
+                   MakeDoubleChecker<double> (0))
   ;
   return tid;
 }
@@ -47,37 +73,55 @@ TypeId NodeOption::GetInstanceTypeId (void) const
 
 void NodeOption::Print (std::ostream &os) const
 {
-  os << "pktsPerSec=" << m_pktsPerSec << " "
-     << "skippedPkts=" << m_skippedPkts << " "
-     << "icn=" << m_icn << " "
-     << "pktsSinceLastICD=" << m_pktsSinceLastICD << " "
-     << "parentTa=" << m_Ta << " "
-     << "parentTs=" << m_Ts << " "
-     << "parentOffsprings" << m_parentOffsprings << " "
-     << "sp=" << m_sp << " "
-     << "gp=" << m_gp << " ";
+  os << "Ta=" << m_Ta << " "
+     << "Ts=" << m_Ts << " "
+     << "offsprings=" << m_Offsprings << " "
+     << "gp=" << m_gp << " "
+     << "pathDegree=" << m_pathDegree << " ";
 }
 
+uint32_t NodeOption::EncodeFixed (double value, int fracBits, int bits)
+{
+  NS_ASSERT (bits > 0 && bits <= 32 && fracBits < bits);
+  double maxRaw = std::ldexp (1.0, bits) - 1;
+  double raw = std::floor (std::ldexp (value, fracBits) + 0.5);
+  if (!(raw > 0))
+    {
+      return 0;   // negative or NaN
+    }
+  if (raw > maxRaw)
+    {
+      return static_cast<uint32_t> (maxRaw);
+    }
+  return static_cast<uint32_t> (raw);
+}
+
+double NodeOption::DecodeFixed (uint32_t raw, int fracBits)
+{
+  return std::ldexp (static_cast<double> (raw), -fracBits);
+}
+
+// length (1) + Ta (4) + Ts (4) + offsprings (1) + gp (2) + path degree (2)
 int NodeOption::GetSerializedSize (void) const
 {
-  return 19;
+  return 14;
 }
 
+// Only the state a child needs to compute its scheduling rate is carried:
+// the congestion degree inputs, the active offsprings, the GP and the
+// path degree. The scheduling rate is not carried: each child derives its
+// own from these fields.
 void NodeOption::Serialize (Buffer::Iterator start) const
 {
   NS_LOG_FUNCTION (this);
   Buffer::Iterator i = start;
 
-  i.WriteU8 (20); //length
-  i.WriteHtonU16(m_pktsPerSec);
-  i.WriteU8(m_skippedPkts); 
-  i.WriteU8(m_icn); 
-  i.WriteHtonU16(m_pktsSinceLastICD);
-  i.WriteHtonU32(m_Ta);
-  i.WriteHtonU32(m_Ts);
-  i.WriteU8(m_parentOffsprings);
-  i.WriteU8(m_sp);
-  i.WriteU8(m_gp);
+  i.WriteU8 (GetSerializedSize ()); //length
+  i.WriteHtonU32 (EncodeFixed (m_Ta, TIME_FRAC_BITS, 32));
+  i.WriteHtonU32 (EncodeFixed (m_Ts, TIME_FRAC_BITS, 32));
+  i.WriteU8 (m_Offsprings);
+  i.WriteHtonU16 (m_gp);
+  i.WriteHtonU16 (EncodeFixed (m_pathDegree, DEGREE_FRAC_BITS, 16));
 }
 
 int NodeOption::Deserialize (Buffer::Iterator start)
@@ -88,24 +132,94 @@ int NodeOption::Deserialize (Buffer::Iterator start)
   int length = i.ReadU8();
   if (length != GetSerializedSize())
   {
-    NS_LOG_WARN ("Malformed Ipv4 Header option");
+    NS_LOG_WARN ("Malformed PCCP node option");
     return 0;
   }
 
-  m_pktsPerSec = i.ReadNtohU16();
-  m_skippedPkts = i.ReadU8();
-  m_icn = i.ReadU8();
-  m_pktsSinceLastICD = i.ReadNtohU16();
-  m_Ta = i.ReadNtohU32();
-  m_Ts = i.ReadNtohU32();
-  m_parentOffsprings = i.ReadU8();
-  m_sp = i.ReadU8();
-  m_gp = i.ReadU8();  
+  m_Ta = DecodeFixed (i.ReadNtohU32 (), TIME_FRAC_BITS);
+  m_Ts = DecodeFixed (i.ReadNtohU32 (), TIME_FRAC_BITS);
+  m_Offsprings = i.ReadU8 ();
+  m_gp = i.ReadNtohU16 ();
+  m_pathDegree = DecodeFixed (i.ReadNtohU16 (), DEGREE_FRAC_BITS);
 
   return GetSerializedSize ();
 }
 
 
+void NodeOption::NotifyConstructionCompleted (void){
+  NS_ASSERT (m_estimatorType.IsChildOf (PccpEstimator::GetTypeId ()));
+
+  ObjectFactory factory;
+  factory.SetTypeId (m_estimatorType);
+  m_taEstimator = factory.Create<PccpEstimator> ();
+  m_tsEstimator = factory.Create<PccpEstimator> ();
+
+  SetTa (m_initialTa);
+  SetTs (m_initialTs);
+  SetSvc (m_initialSvc);
+
+  Object::NotifyConstructionCompleted ();
+}
+
+void NodeOption::AddTaSample(double sample){
+  m_taEstimator->Measurement (sample);
+  m_Ta = m_taEstimator->GetEstimate ();
+}
+
+void NodeOption::AddTsSample(double sample){
+  m_tsEstimator->Measurement (sample);
+  m_Ts = m_tsEstimator->GetEstimate ();
+}
+
+void NodeOption::UpdatePathDegree(void){
+  m_pathDegree = m_Ta > 0 ? m_Ts / m_Ta : 0;
+  if(m_parentOption && m_parentOption->GetPathDegree() > m_pathDegree){
+    m_pathDegree = m_parentOption->GetPathDegree();
+  }
+}
+
+void NodeOption::AttachNode(Ptr<Node> node, Ptr<Node> parent){
+  Ptr<NodeOption> option = node->GetNodeOption();
+  NS_ASSERT_MSG (option, "Node option must be set before the parent node");
+  int gp = option->GetGP();
+
+  if(node->GetParentNode() && !option->m_idle){
+    PropagateGp(node->GetParentNode(), -gp);
+  }
+  node->SetParentNode(parent);
+  if(parent && !option->m_idle){
+    PropagateGp(parent, gp);
+  }
+}
+
+void NodeOption::SetNodeIdle(Ptr<Node> node, bool idle){
+  Ptr<NodeOption> option = node->GetNodeOption();
+  if(idle == option->m_idle){
+    return;
+  }
+  option->m_idle = idle;
+  if(node->GetParentNode()){
+    int gp = option->GetGP();
+    PropagateGp(node->GetParentNode(), idle ? -gp : gp);
+  }
+}
+
+bool NodeOption::IsIdle(void) const{
+  return m_idle;
+}
+
+void NodeOption::PropagateGp(Ptr<Node> node, int delta){
+  // O(depth) instead of recomputing the GP of the whole tree
+  for(; node; node = node->GetParentNode()){
+    Ptr<NodeOption> option = node->GetNodeOption();
+    option->SetGP(option->GetGP() + delta);
+    NS_LOG_LOGIC ("node=" << node->GetId() << ": GP=" << option->GetGP());
+    if(option->m_idle){
+      break;
+    }
+  }
+}
+
 void NodeOption::SetPktsPerSec(int pktsPerSec){
   m_pktsPerSec = pktsPerSec;
 }
@@ -124,10 +238,18 @@ void NodeOption::SetPktsSinceLastICD(int pktsSinceLastICD){
 
 void NodeOption::SetTa(double ta){
   m_Ta = ta;
+  if (m_taEstimator)
+  {
+    m_taEstimator->SetEstimate (ta);
+  }
 }
 
 void NodeOption::SetTs(double ts){
   m_Ts = ts;
+  if (m_tsEstimator)
+  {
+    m_tsEstimator->SetEstimate (ts);
+  }
 }
 
 void NodeOption::SetParentOffsprings(int parentOffsprings){
@@ -162,6 +284,14 @@ void NodeOption::SetParentAddress(Address parentAddress){
   m_parentAddress = parentAddress;
 }
 
+void NodeOption::SetParentMacAddress(Address parentMacAddress){
+  m_parentMacAddress = parentMacAddress;
+}
+
+void NodeOption::SetParentOption(Ptr<NodeOption> parentOption){
+  m_parentOption = parentOption;
+}
+
 
 int NodeOption:: GetPktsPerSec (void) const{ 
   return m_pktsPerSec;
@@ -204,6 +334,10 @@ double NodeOption::GetSvc(void) const{
   return m_svc;
 }
 
+double NodeOption::GetSourceShare(void) const{
+  return m_gp > 0 ? m_sp * 1.0 / m_gp : 0.0;
+}
+
 int NodeOption::GetOffsprings(void) const{
   return m_Offsprings;
 }
@@ -220,6 +354,18 @@ Address NodeOption::GetParentAddress(void) const{
   return m_parentAddress;
 }
 
+Address NodeOption::GetParentMacAddress(void) const{
+  return m_parentMacAddress;
+}
+
+Ptr<NodeOption> NodeOption::GetParentOption(void) const{
+  return m_parentOption;
+}
+
+double NodeOption::GetPathDegree(void) const{
+  return m_pathDegree;
+}
+
 
 
 }  // namespace ns3
@@ -8,10 +8,13 @@
 #include "ns3/buffer.h"
 #include "ns3/object-factory.h"
 #include "ns3/address.h"
+#include "ns3/pccp-estimator.h"
 
 
 namespace ns3 {
 
+class Node;
+
 class NodeOption : public Object{
 
 public:
@@ -26,6 +29,39 @@ public:
     virtual int Deserialize (Buffer::Iterator start);
     virtual int GetSerializedSize (void) const;
 
+    // Fixed-point wire format of the carried fields. Times (Ta, Ts) are
+    // unsigned Q12.20 in 32 bits: range [0, 4096), resolution 2^-20 (~1 us
+    // when in seconds). Ratios such as the congestion degree are Q8.8 in
+    // 16 bits. Values are rounded to nearest, so the round-trip error is at
+    // most half a resolution step; values out of range saturate.
+    static const int TIME_FRAC_BITS = 20;
+    static const int DEGREE_FRAC_BITS = 8;
+    static uint32_t EncodeFixed (double value, int fracBits, int bits);
+    static double DecodeFixed (uint32_t raw, int fracBits);
+
+    // Ta and Ts are in seconds. Samples are smoothed by two estimators of
+    // the type given by the "Estimator" attribute, starting from the
+    // "InitialTa" / "InitialTs" attributes; SetTa/SetTs override the
+    // current estimate.
+    void AddTaSample(double sample);
+    void AddTsSample(double sample);
+
+    // Path degree: highest congestion degree (Ts/Ta) of this node and its
+    // ancestors, from the path degree last advertised by the parent. It is
+    // what a child of this node reacts to, so that congestion anywhere
+    // upstream throttles the sources below it.
+    void UpdatePathDegree(void);
+
+    // GP bookkeeping along the Node::GetParentNode() chain, so that the GP
+    // of a node is its SP plus the GP of its active children at every
+    // depth; each change costs O(depth). AttachNode sets the parent of a
+    // node and adds its GP to the GP of its ancestors; SetNodeIdle
+    // withdraws it (or gives it back) until the node is active again. The
+    // node options must be set before.
+    static void AttachNode(Ptr<Node> node, Ptr<Node> parent);
+    static void SetNodeIdle(Ptr<Node> node, bool idle);
+    bool IsIdle(void) const;
+
     void SetPktsPerSec(int pktsPerSec);
     void SetSkippedPkts(int skippedPkts);
     void SetIcn(int icn);
@@ -40,6 +76,8 @@ public:
     void SetParentDegree(double parentDegree);
     void SetPktFactor(double pktFactor);
     void SetParentAddress(Address parentAddress);
+    void SetParentMacAddress(Address parentMacAddress);
+    void SetParentOption(Ptr<NodeOption> parentOption);
 
     int GetPktsPerSec (void) const;
     int GetSkippedPkts(void) const;
@@ -51,12 +89,24 @@ public:
     int GetSP(void) const;
     int GetGP(void) const;
     double GetSvc(void) const;
+    // SP/GP, or 0 for a node without traffic priority (GP == 0)
+    double GetSourceShare(void) const;
     int GetOffsprings(void) const;
     double GetParentDegree(void) const;
     double GetPktFactor(void) const;
     Address GetParentAddress(void) const;    
+    Address GetParentMacAddress(void) const;
+    Ptr<NodeOption> GetParentOption(void) const;
+    double GetPathDegree(void) const;
+
+protected:
+    virtual void NotifyConstructionCompleted (void);
 
 private:
+    // add delta to the GP of node and of its ancestors, up to the first
+    // idle one whose GP is not counted by its parent
+    static void PropagateGp(Ptr<Node> node, int delta);
+
     int    m_pktsPerSec;
     int     m_skippedPkts;
     int     m_icn;
@@ -69,8 +119,18 @@ private:
     double  m_svc;
     int m_Offsprings;
     double m_parentDegree;
+    double m_pathDegree;
+    bool m_idle;                      // GP withdrawn from the ancestors
     double m_pktFactor;
     Address m_parentAddress;
+    Address m_parentMacAddress;       // MAC address of the parent on the upstream channel
+    Ptr<NodeOption> m_parentOption;   // congestion state last advertised by the parent
+    TypeId m_estimatorType;
+    double m_initialTa;
+    double m_initialTs;
+    double m_initialSvc;
+    Ptr<PccpEstimator> m_taEstimator;
+    Ptr<PccpEstimator> m_tsEstimator;
 };
 
 }  // namespace ns3
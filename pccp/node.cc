@@ -388,19 +388,6 @@ Ptr<Node> Node::GetParentNode(void) const{
   return m_parent;
 }
 
-void Node::SetPrevNode(Ptr<Node> node){
-  m_prev = node;
-}
-Ptr<Node> Node::GetPrevNode(void) const{
-  return m_prev;
-}
-
-// Time Node::GetEntrTimeInMac(void) const{
-//   return Simulator::Now();
-// }
-// void Node::SetEntrTimeInMac(Time time){
-//   //m_entrTimeInMac = time;
-// }  
 
 
 /*------------------ my changes ends ------------------*/
@@ -214,13 +214,10 @@ public:
 
   void SetNodeOption(Ptr<NodeOption> nodeOption);
   Ptr<NodeOption> GetNodeOption(void) const;
+  // Plain holders: the GP bookkeeping along the parent chain is done by
+  // NodeOption::AttachNode and NodeOption::SetNodeIdle.
   void SetParentNode(Ptr<Node> node);
   Ptr<Node> GetParentNode(void) const;
-  void SetPrevNode(Ptr<Node> node);
-  Ptr<Node> GetPrevNode(void) const;
-  // Time GetEntrTimeInMac(void) const;
-  // void SetEntrTimeInMac(Time time);
-  int entrTimeInMac;  
 
   /*------------------ my changes ends ------------------*/
 
@@ -308,7 +305,6 @@ private:
 
   Ptr<NodeOption> m_nodeOption;
   Ptr<Node> m_parent;
-  Ptr<Node> m_prev;
 
   /*------------------ my changes ends ------------------*/
 };
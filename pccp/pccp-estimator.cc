@@ -0,0 +1,218 @@
+/*------------------------- my changes starts ---------------------------*/
+
+#include "pccp-estimator.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PccpEstimator");
+
+NS_OBJECT_ENSURE_REGISTERED (PccpEstimator);
+
+TypeId PccpEstimator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpEstimator")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+  ;
+  return tid;
+}
+
+PccpEstimator::PccpEstimator ()
+  : m_estimate (0),
+    m_nSamples (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PccpEstimator::~PccpEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void PccpEstimator::SetEstimate (double estimate)
+{
+  NS_LOG_FUNCTION (this << estimate);
+  m_estimate = estimate;
+}
+
+double PccpEstimator::GetEstimate (void) const
+{
+  return m_estimate;
+}
+
+uint32_t PccpEstimator::GetNSamples (void) const
+{
+  return m_nSamples;
+}
+
+
+NS_OBJECT_ENSURE_REGISTERED (PccpEwmaEstimator);
+
+TypeId PccpEwmaEstimator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpEwmaEstimator")
+    .SetParent<PccpEstimator> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<PccpEwmaEstimator> ()
+    .AddAttribute ("Alpha",
+                   "Weight of a new sample",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&PccpEwmaEstimator::m_alpha),
+                   MakeDoubleChecker<double> (0, 1))
+  ;
+  return tid;
+}
+
+PccpEwmaEstimator::PccpEwmaEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PccpEwmaEstimator::~PccpEwmaEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void PccpEwmaEstimator::Measurement (double sample)
+{
+  NS_LOG_FUNCTION (this << sample);
+  m_estimate = (1 - m_alpha) * m_estimate + m_alpha * sample;
+  m_nSamples++;
+}
+
+
+NS_OBJECT_ENSURE_REGISTERED (PccpWindowEstimator);
+
+TypeId PccpWindowEstimator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpWindowEstimator")
+    .SetParent<PccpEstimator> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<PccpWindowEstimator> ()
+    .AddAttribute ("WindowSize",
+                   "Number of samples averaged",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&PccpWindowEstimator::SetWindowSize,
+                                         &PccpWindowEstimator::GetWindowSize),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+PccpWindowEstimator::PccpWindowEstimator ()
+  : m_next (0),
+    m_filled (0),
+    m_sum (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PccpWindowEstimator::~PccpWindowEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void PccpWindowEstimator::SetWindowSize (uint32_t size)
+{
+  NS_LOG_FUNCTION (this << size);
+  m_window.assign (size, 0.0);
+  m_next = 0;
+  m_filled = 0;
+  m_sum = 0;
+}
+
+uint32_t PccpWindowEstimator::GetWindowSize (void) const
+{
+  return m_window.size ();
+}
+
+void PccpWindowEstimator::Measurement (double sample)
+{
+  NS_LOG_FUNCTION (this << sample);
+
+  if (m_filled == m_window.size ())
+    {
+      m_sum -= m_window[m_next];
+    }
+  else
+    {
+      m_filled++;
+    }
+  m_window[m_next] = sample;
+  m_sum += sample;
+  m_next = (m_next + 1) % m_window.size ();
+
+  m_estimate = m_sum / m_filled;
+  m_nSamples++;
+}
+
+void PccpWindowEstimator::SetEstimate (double estimate)
+{
+  NS_LOG_FUNCTION (this << estimate);
+  // an explicit estimate replaces the samples in the window
+  SetWindowSize (m_window.size ());
+  m_estimate = estimate;
+}
+
+
+NS_OBJECT_ENSURE_REGISTERED (PccpKalmanEstimator);
+
+TypeId PccpKalmanEstimator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpKalmanEstimator")
+    .SetParent<PccpEstimator> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<PccpKalmanEstimator> ()
+    .AddAttribute ("ProcessNoise",
+                   "Variance of the drift of the true time between two samples, in s^2",
+                   DoubleValue (1e-8),
+                   MakeDoubleAccessor (&PccpKalmanEstimator::m_processNoise),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("MeasurementNoise",
+                   "Variance of a single sample, in s^2",
+                   DoubleValue (1e-6),
+                   MakeDoubleAccessor (&PccpKalmanEstimator::m_measurementNoise),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("InitialError",
+                   "Variance of the initial estimate, in s^2",
+                   DoubleValue (1e-4),
+                   MakeDoubleAccessor (&PccpKalmanEstimator::m_error),
+                   MakeDoubleChecker<double> (0))
+  ;
+  return tid;
+}
+
+PccpKalmanEstimator::PccpKalmanEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PccpKalmanEstimator::~PccpKalmanEstimator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void PccpKalmanEstimator::Measurement (double sample)
+{
+  NS_LOG_FUNCTION (this << sample);
+
+  // predict: the estimate carries over, its uncertainty grows by the drift
+  m_error += m_processNoise;
+
+  // update
+  double gain = 1.0;
+  if (m_error + m_measurementNoise > 0)
+    {
+      gain = m_error / (m_error + m_measurementNoise);
+    }
+  m_estimate += gain * (sample - m_estimate);
+  m_error *= (1 - gain);
+  m_nSamples++;
+}
+
+}  // namespace ns3
+
+/*------------------------- my changes ends ----------------------------*/
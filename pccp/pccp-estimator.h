@@ -0,0 +1,151 @@
+/*------------------------- my changes starts ---------------------------*/
+
+#ifndef PCCP_ESTIMATOR_H
+#define PCCP_ESTIMATOR_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/object.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Base class of the estimators smoothing the PCCP time samples
+ *        (packet inter-arrival time Ta, packet service time Ts).
+ *
+ * Samples and estimates are in seconds. Until the first sample the
+ * estimate is the initial value given with SetEstimate.
+ */
+class PccpEstimator : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PccpEstimator ();
+  virtual ~PccpEstimator ();
+
+  /**
+   * \brief Add a new sample.
+   * \param sample the measured time, in seconds
+   */
+  virtual void Measurement (double sample) = 0;
+  /**
+   * \brief Override the current estimate, e.g. with an initial value.
+   * \param estimate the estimate, in seconds
+   */
+  virtual void SetEstimate (double estimate);
+  /**
+   * \return the current estimate, in seconds
+   */
+  double GetEstimate (void) const;
+  /**
+   * \return the number of samples added so far
+   */
+  uint32_t GetNSamples (void) const;
+
+protected:
+  double m_estimate;      //!< current estimate
+  uint32_t m_nSamples;    //!< number of samples added
+};
+
+/**
+ * \ingroup internet
+ *
+ * \brief Exponentially weighted moving average:
+ *        estimate = (1 - alpha) * estimate + alpha * sample.
+ */
+class PccpEwmaEstimator : public PccpEstimator
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PccpEwmaEstimator ();
+  virtual ~PccpEwmaEstimator ();
+
+  virtual void Measurement (double sample);
+
+private:
+  double m_alpha;         //!< weight of a new sample
+};
+
+/**
+ * \ingroup internet
+ *
+ * \brief Mean of the last WindowSize samples, kept in a ring buffer.
+ */
+class PccpWindowEstimator : public PccpEstimator
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PccpWindowEstimator ();
+  virtual ~PccpWindowEstimator ();
+
+  virtual void Measurement (double sample);
+  virtual void SetEstimate (double estimate);
+
+private:
+  /**
+   * \param size the number of samples averaged
+   */
+  void SetWindowSize (uint32_t size);
+  /**
+   * \return the number of samples averaged
+   */
+  uint32_t GetWindowSize (void) const;
+
+  std::vector<double> m_window;   //!< ring buffer of the last samples
+  uint32_t m_next;                //!< slot of the next sample
+  uint32_t m_filled;              //!< number of valid slots
+  double m_sum;                   //!< sum of the valid slots
+};
+
+/**
+ * \ingroup internet
+ *
+ * \brief Scalar Kalman filter modelling the time as a random walk.
+ *
+ * The ProcessNoise variance sets how fast the true value is expected to
+ * drift, the MeasurementNoise variance how noisy a single sample is. Their
+ * ratio trades reaction time against noise rejection.
+ */
+class PccpKalmanEstimator : public PccpEstimator
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PccpKalmanEstimator ();
+  virtual ~PccpKalmanEstimator ();
+
+  virtual void Measurement (double sample);
+
+private:
+  double m_processNoise;       //!< variance of the drift between two samples
+  double m_measurementNoise;   //!< variance of a sample
+  double m_error;              //!< variance of the estimate
+};
+
+}  // namespace ns3
+
+
+#endif /* PCCP_ESTIMATOR_H */
+
+/*------------------------- my changes ends ----------------------------*/
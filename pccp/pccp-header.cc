@@ -0,0 +1,97 @@
+/*------------------------- my changes starts ---------------------------*/
+
+#include "pccp-header.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PccpHeader");
+NS_OBJECT_ENSURE_REGISTERED (PccpHeader);
+
+PccpHeader::PccpHeader ()
+  : m_protocol (0)
+{
+}
+
+PccpHeader::~PccpHeader ()
+{
+}
+
+TypeId PccpHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<PccpHeader> ()
+  ;
+  return tid;
+}
+
+TypeId PccpHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void PccpHeader::Print (std::ostream &os) const
+{
+  os << "protocol=" << m_protocol << " ";
+  if (m_option)
+    {
+      m_option->Print (os);
+    }
+}
+
+uint32_t PccpHeader::GetSerializedSize (void) const
+{
+  NS_ASSERT_MSG (m_option, "No NodeOption to carry");
+  return 2 + m_option->GetSerializedSize ();
+}
+
+void PccpHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+
+  i.WriteHtonU16 (m_protocol);
+  m_option->Serialize (i);
+}
+
+uint32_t PccpHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  m_protocol = i.ReadNtohU16 ();
+
+  // the first byte of the option is its length
+  Buffer::Iterator optionStart = i;
+  uint8_t length = i.ReadU8 ();
+  if (m_option)
+    {
+      m_option->Deserialize (optionStart);
+    }
+
+  return 2 + length;
+}
+
+void PccpHeader::SetProtocol (uint16_t protocol)
+{
+  m_protocol = protocol;
+}
+
+uint16_t PccpHeader::GetProtocol (void) const
+{
+  return m_protocol;
+}
+
+void PccpHeader::SetNodeOption (Ptr<NodeOption> option)
+{
+  m_option = option;
+}
+
+Ptr<NodeOption> PccpHeader::GetNodeOption (void) const
+{
+  return m_option;
+}
+
+}  // namespace ns3
+
+/*------------------------- my changes ends ----------------------------*/
@@ -0,0 +1,76 @@
+/*------------------------- my changes starts ---------------------------*/
+
+#ifndef PCCP_HEADER_H
+#define PCCP_HEADER_H
+
+#include "ns3/header.h"
+#include "ns3/node-option.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Shim header piggybacking the PCCP congestion state of the sender
+ *        on every packet it transmits.
+ *
+ * The header is added by the TrafficControlLayer right before a packet is
+ * handed to the NetDevice, which then sends it with the PROT_NUMBER EtherType.
+ * It carries the EtherType of the encapsulated packet followed by the
+ * serialized NodeOption of the sender. The receiving TrafficControlLayer
+ * removes it, restores the original protocol and, if the packet comes from
+ * its parent, deserializes the state into its mirror of the parent NodeOption.
+ */
+class PccpHeader : public Header
+{
+public:
+  /// EtherType of packets carrying a PccpHeader (IEEE 802 local experimental)
+  static const uint16_t PROT_NUMBER = 0x88B5;
+
+  PccpHeader ();
+  virtual ~PccpHeader ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+  /**
+   * \param protocol the EtherType of the encapsulated packet
+   */
+  void SetProtocol (uint16_t protocol);
+  /**
+   * \return the EtherType of the encapsulated packet
+   */
+  uint16_t GetProtocol (void) const;
+  /**
+   * \brief Set the NodeOption serialized into, or deserialized from, the header.
+   *
+   * If no NodeOption is set before deserialization, the carried state is
+   * skipped.
+   *
+   * \param option the NodeOption
+   */
+  void SetNodeOption (Ptr<NodeOption> option);
+  /**
+   * \return the NodeOption carried by the header
+   */
+  Ptr<NodeOption> GetNodeOption (void) const;
+
+private:
+  uint16_t m_protocol;         //!< EtherType of the encapsulated packet
+  Ptr<NodeOption> m_option;    //!< congestion state of the sender
+};
+
+}  // namespace ns3
+
+
+#endif /* PCCP_HEADER_H */
+
+/*------------------------- my changes ends ----------------------------*/
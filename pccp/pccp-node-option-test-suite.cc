@@ -0,0 +1,193 @@
+/*------------------------- my changes starts ---------------------------*/
+
+#include <cmath>
+#include <limits>
+#include "ns3/test.h"
+#include "ns3/buffer.h"
+#include "ns3/packet.h"
+#include "ns3/node-option.h"
+#include "ns3/pccp-header.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Round-trip error, saturation and invalid input of the fixed-point
+ *        encoding of the NodeOption fields.
+ */
+class PccpFixedPointTestCase : public TestCase
+{
+public:
+  PccpFixedPointTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Check the round-trip error of a value.
+   * \param value the encoded value
+   * \param fracBits the number of fractional bits
+   * \param bits the width of the field
+   */
+  void CheckRoundTrip (double value, int fracBits, int bits);
+};
+
+PccpFixedPointTestCase::PccpFixedPointTestCase ()
+  : TestCase ("Fixed-point encoding of the NodeOption fields")
+{
+}
+
+void
+PccpFixedPointTestCase::CheckRoundTrip (double value, int fracBits, int bits)
+{
+  double decoded = NodeOption::DecodeFixed (NodeOption::EncodeFixed (value, fracBits, bits), fracBits);
+  // half a resolution step
+  double bound = std::ldexp (1.0, -fracBits - 1);
+  NS_TEST_EXPECT_MSG_EQ_TOL (decoded, value, bound,
+                             "Q" << bits - fracBits << "." << fracBits << " round trip of " << value);
+}
+
+void
+PccpFixedPointTestCase::DoRun (void)
+{
+  const int timeBits = NodeOption::TIME_FRAC_BITS;
+  const int degreeBits = NodeOption::DEGREE_FRAC_BITS;
+
+  // Q12.20 times: error <= 2^-21 over the range, down to microseconds
+  double times[] = {0, 1e-6, 1.5e-6, 12.3e-6, 1e-3, 0.0123456, 0.1, 0.999999,
+                    1.0, 3.14159265, 100.000001, 4095.999};
+  for (double t : times)
+    {
+      CheckRoundTrip (t, timeBits, 32);
+    }
+
+  // Q8.8 degrees: error <= 2^-9
+  double degrees[] = {0, 0.001, 0.5, 0.9999, 1.0, 1.33333, 2.71828, 3.0, 100.1, 255.99};
+  for (double d : degrees)
+    {
+      CheckRoundTrip (d, degreeBits, 16);
+    }
+
+  // out of range values saturate
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (5000.0, timeBits, 32), 0xffffffffu,
+                         "Q12.20 does not saturate");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (1e300, timeBits, 32), 0xffffffffu,
+                         "Q12.20 does not saturate");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (300.0, degreeBits, 16), 0xffffu,
+                         "Q8.8 does not saturate");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (std::numeric_limits<double>::infinity (), degreeBits, 16),
+                         0xffffu, "Q8.8 does not saturate on infinity");
+
+  // negative and NaN values are encoded as 0
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (-0.5, timeBits, 32), 0u, "negative time not 0");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (-2.0, degreeBits, 16), 0u, "negative degree not 0");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (std::nan (""), timeBits, 32), 0u, "NaN time not 0");
+  NS_TEST_EXPECT_MSG_EQ (NodeOption::EncodeFixed (std::nan (""), degreeBits, 16), 0u, "NaN degree not 0");
+}
+
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Serialize / Deserialize round trip of a NodeOption, alone and
+ *        carried in a PccpHeader.
+ */
+class PccpNodeOptionSerializationTestCase : public TestCase
+{
+public:
+  PccpNodeOptionSerializationTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Check the carried fields of a deserialized NodeOption.
+   * \param sent the serialized NodeOption
+   * \param received the deserialized NodeOption
+   */
+  void CheckFields (Ptr<NodeOption> sent, Ptr<NodeOption> received);
+};
+
+PccpNodeOptionSerializationTestCase::PccpNodeOptionSerializationTestCase ()
+  : TestCase ("NodeOption and PccpHeader serialization round trip")
+{
+}
+
+void
+PccpNodeOptionSerializationTestCase::CheckFields (Ptr<NodeOption> sent, Ptr<NodeOption> received)
+{
+  double timeBound = std::ldexp (1.0, -NodeOption::TIME_FRAC_BITS - 1);
+  double degreeBound = std::ldexp (1.0, -NodeOption::DEGREE_FRAC_BITS - 1);
+
+  NS_TEST_EXPECT_MSG_EQ_TOL (received->GetTa (), sent->GetTa (), timeBound, "Ta");
+  NS_TEST_EXPECT_MSG_EQ_TOL (received->GetTs (), sent->GetTs (), timeBound, "Ts");
+  NS_TEST_EXPECT_MSG_EQ (received->GetOffsprings (), sent->GetOffsprings (), "offsprings");
+  NS_TEST_EXPECT_MSG_EQ (received->GetGP (), sent->GetGP (), "GP");
+  NS_TEST_EXPECT_MSG_EQ_TOL (received->GetPathDegree (), sent->GetPathDegree (), degreeBound, "path degree");
+}
+
+void
+PccpNodeOptionSerializationTestCase::DoRun (void)
+{
+  Ptr<NodeOption> sent = CreateObject<NodeOption> ();
+  sent->SetTa (0.0123456);
+  sent->SetTs (0.0234567);
+  sent->SetOffsprings (5);
+  sent->SetGP (300);
+  sent->UpdatePathDegree ();
+
+  Buffer buffer;
+  buffer.AddAtStart (sent->GetSerializedSize ());
+  sent->Serialize (buffer.Begin ());
+
+  Ptr<NodeOption> received = CreateObject<NodeOption> ();
+  NS_TEST_EXPECT_MSG_EQ (received->Deserialize (buffer.Begin ()), sent->GetSerializedSize (),
+                         "wrong deserialized size");
+  CheckFields (sent, received);
+
+  // a wrong length leaves the option untouched
+  buffer.Begin ().WriteU8 (sent->GetSerializedSize () + 1);
+  Ptr<NodeOption> malformed = CreateObject<NodeOption> ();
+  NS_TEST_EXPECT_MSG_EQ (malformed->Deserialize (buffer.Begin ()), 0, "malformed option accepted");
+  NS_TEST_EXPECT_MSG_EQ (malformed->GetGP (), 0, "malformed option deserialized");
+
+  // carried in a PccpHeader
+  PccpHeader header;
+  header.SetProtocol (0x0800);
+  header.SetNodeOption (sent);
+  Ptr<Packet> packet = Create<Packet> (100);
+  packet->AddHeader (header);
+  NS_TEST_EXPECT_MSG_EQ (packet->GetSize (), 100 + header.GetSerializedSize (), "wrong header size");
+
+  PccpHeader receivedHeader;
+  Ptr<NodeOption> mirror = CreateObject<NodeOption> ();
+  receivedHeader.SetNodeOption (mirror);
+  NS_TEST_EXPECT_MSG_EQ (packet->RemoveHeader (receivedHeader), header.GetSerializedSize (),
+                         "wrong removed size");
+  NS_TEST_EXPECT_MSG_EQ (receivedHeader.GetProtocol (), 0x0800, "protocol");
+  NS_TEST_EXPECT_MSG_EQ (packet->GetSize (), 100u, "payload");
+  CheckFields (sent, mirror);
+}
+
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief PCCP NodeOption TestSuite
+ */
+class PccpNodeOptionTestSuite : public TestSuite
+{
+public:
+  PccpNodeOptionTestSuite ()
+    : TestSuite ("pccp-node-option", UNIT)
+  {
+    AddTestCase (new PccpFixedPointTestCase, TestCase::QUICK);
+    AddTestCase (new PccpNodeOptionSerializationTestCase, TestCase::QUICK);
+  }
+};
+
+static PccpNodeOptionTestSuite g_pccpNodeOptionTestSuite; //!< Static variable for test initialization
+
+/*------------------------- my changes ends ----------------------------*/
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+#
+# Runs independent replications of pccpTest in parallel, one process per
+# replication with its own run number and working directory, and aggregates
+# their results (mean and 95% confidence interval per parameter point).
+#
+# Copy to the ns-3.xx directory and build once, then e.g.:
+#
+#   ./pccp-runner.py --runs 20 --param nFlows=10,20,30 --param coverage=1,2
+#
+# Arguments after "--" are passed unchanged to every replication.
+
+import argparse
+import csv
+import glob
+import itertools
+import math
+import os
+import re
+import subprocess
+import sys
+import xml.etree.ElementTree as ET
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+# two-sided 95% Student t quantiles, by degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+METRICS = ['throughput_mbps', 'mean_delay_ms', 'loss_ratio', 'signaling_bytes', 'jain_index']
+
+
+def parse_time(value):
+    """ns-3 Time as written by FlowMonitor, e.g. '+1.1e+09ns', in seconds."""
+    return float(value.strip().lstrip('+').rstrip('ns')) * 1e-9
+
+
+def parse_run(run_dir):
+    flows = ET.parse(os.path.join(run_dir, 'flow.xml')).getroot().find('FlowStats')
+    throughput = 0.0
+    delay = 0.0
+    rx_packets = 0
+    tx_packets = 0
+    lost_packets = 0
+    for flow in flows.findall('Flow'):
+        rx = int(flow.get('rxPackets'))
+        rx_packets += rx
+        tx_packets += int(flow.get('txPackets'))
+        lost_packets += int(flow.get('lostPackets'))
+        if rx == 0:
+            continue
+        duration = parse_time(flow.get('timeLastRxPackets')) - parse_time(flow.get('timeFirstTxPackets'))
+        if duration > 0:
+            throughput += int(flow.get('rxBytes')) * 8 / duration / 1e6
+        delay += parse_time(flow.get('delaySum'))
+
+    with open(os.path.join(run_dir, 'run.log')) as log:
+        output = log.read()
+    match = re.search(r'PCCP signaling overhead: (\d+) bytes', output)
+    jain = re.search(r"Jain's fairness index of throughput/SP: ([0-9.eE+-]+)", output)
+
+    return {
+        'throughput_mbps': throughput,
+        'mean_delay_ms': delay / rx_packets * 1e3 if rx_packets else float('nan'),
+        'loss_ratio': lost_packets / tx_packets if tx_packets else float('nan'),
+        'signaling_bytes': float(match.group(1)) if match else float('nan'),
+        'jain_index': float(jain.group(1)) if jain else float('nan'),
+    }
+
+
+def find_binary(ns3_dir, program):
+    """Executable of a program, e.g. 'scratch/pccpTest'. waf names it
+    build/scratch/ns3.35-pccpTest-<profile>; the most recently built
+    profile wins."""
+    exact = os.path.join(ns3_dir, 'build', program)
+    if os.path.isfile(exact):
+        return exact
+    directory, name = os.path.split(program)
+    matches = glob.glob(os.path.join(ns3_dir, 'build', directory, 'ns3*-%s-*' % name))
+    matches = [m for m in matches if os.path.isfile(m) and os.access(m, os.X_OK)]
+    if not matches:
+        return None
+    return max(matches, key=os.path.getmtime)
+
+
+def run_one(binary, env, run_dir, args):
+    os.makedirs(run_dir, exist_ok=True)
+    with open(os.path.join(run_dir, 'run.log'), 'w') as log:
+        code = subprocess.call([binary] + args, cwd=run_dir, env=env,
+                               stdout=log, stderr=subprocess.STDOUT)
+    if code != 0:
+        raise RuntimeError('%s exited with %d, see %s/run.log' % (binary, code, run_dir))
+    return parse_run(run_dir)
+
+
+def mean_ci(values):
+    values = [v for v in values if not math.isnan(v)]
+    n = len(values)
+    if n == 0:
+        return float('nan'), float('nan')
+    mean = sum(values) / n
+    if n == 1:
+        return mean, float('nan')
+    stddev = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1))
+    t = T95[n - 2] if n - 2 < len(T95) else 1.960
+    return mean, t * stddev / math.sqrt(n)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Parallel replications of pccpTest')
+    parser.add_argument('--ns3-dir', default='.', help='ns-3.xx directory')
+    parser.add_argument('--program', default='scratch/pccpTest', help='program to run, as given to "./waf --run"')
+    parser.add_argument('--runs', type=int, default=10, help='replications per parameter point')
+    parser.add_argument('--first-run', type=int, default=1, help='run number of the first replication')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count(), help='parallel processes')
+    parser.add_argument('--param', action='append', default=[], metavar='NAME=V1,V2,...',
+                        help='pccpTest argument to sweep; may be repeated')
+    parser.add_argument('--out-dir', default='Output/pccpRuns', help='directory of the runs and results')
+    parser.add_argument('--no-build', action='store_true', help='do not build before running')
+    parser.add_argument('extra', nargs='*', help='arguments passed to every replication')
+    opts = parser.parse_args()
+
+    ns3_dir = os.path.abspath(opts.ns3_dir)
+    if not opts.no_build:
+        subprocess.check_call(['./waf', 'build'], cwd=ns3_dir)
+
+    # run the binary directly: concurrent "./waf --run" would contend for the build lock
+    binary = find_binary(ns3_dir, opts.program)
+    if not binary:
+        sys.exit('%s not found in %s, build ns-3 first' % (opts.program, os.path.join(ns3_dir, 'build')))
+    env = dict(os.environ)
+    lib_dir = os.path.join(ns3_dir, 'build', 'lib')
+    env['LD_LIBRARY_PATH'] = lib_dir + os.pathsep + env.get('LD_LIBRARY_PATH', '')
+
+    names = []
+    values = []
+    for param in opts.param:
+        name, _, choices = param.partition('=')
+        names.append(name)
+        values.append(choices.split(','))
+    points = list(itertools.product(*values))
+    out_dir = os.path.abspath(opts.out_dir)
+
+    results = {point: [] for point in points}
+    with ThreadPoolExecutor(max_workers=opts.jobs) as pool:
+        jobs = {}
+        for point in points:
+            tag = '_'.join('%s-%s' % nv for nv in zip(names, point)) or 'default'
+            for run in range(opts.first_run, opts.first_run + opts.runs):
+                args = ['--%s=%s' % nv for nv in zip(names, point)]
+                # no NetAnim trace unless asked for in the extra arguments
+                args += ['--run=%d' % run, '--anim=off'] + opts.extra
+                run_dir = os.path.join(out_dir, tag, 'run-%d' % run)
+                jobs[pool.submit(run_one, binary, env, run_dir, args)] = point
+        for done, job in enumerate(as_completed(jobs), 1):
+            results[jobs[job]].append(job.result())
+            print('%d/%d replications done' % (done, len(jobs)), file=sys.stderr)
+
+    header = names + ['runs']
+    for metric in METRICS:
+        header += [metric, metric + '_ci95']
+    rows = []
+    for point in points:
+        row = list(point) + [len(results[point])]
+        for metric in METRICS:
+            row += ['%.6g' % x for x in mean_ci([r[metric] for r in results[point]])]
+        rows.append(row)
+
+    with open(os.path.join(out_dir, 'results.csv'), 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(header)
+        writer.writerows(rows)
+
+    widths = [max(len(str(c)) for c in column) for column in zip(header, *rows)]
+    for row in [header] + rows:
+        print('  '.join(str(c).rjust(w) for c, w in zip(row, widths)))
+
+
+if __name__ == '__main__':
+    main()
@@ -7,6 +7,7 @@
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
 #include "ns3/v4ping-helper.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/applications-module.h"
@@ -14,8 +15,14 @@
 #include "ns3/netanim-module.h"
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
 #include <vector>
-#include<time.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
 #include "ns3/yans-error-rate-model.h"
 #include "ns3/wifi-net-device.h"
 #include <fstream>
@@ -30,18 +37,22 @@ using namespace ns3;
 
 
 /*
-Default Network Topology
-
-  Wifi 10.1.1.0                                            Wifi 10.1.3.0                  
-    *   *   *                  *                           *    *    *    *
-    |   |   |    10.1.4.0      |          10.1.5.0         |    |    |    |
-    n4  n3  n0 --------------  n1  ----------------------  n2   n7   n8   n9    
-                  p2p                         p2p
-                               n5 - *
-                              
-                               n6 - *  
-                              
-                          Wifi 10.1.2.0
+Network Topology
+
+  A complete tree of the given depth and fan-out, numbered level by level
+  (root n0, children of node n are n*fanOut+1 ... n*fanOut+fanOut). Every
+  non-leaf node is the AP of a Wi-Fi cell of its own whose STAs are its
+  children, so a non-leaf node other than the root has two devices: a STA
+  in its parent's cell and the AP of its own cell. Cell c (AP n_c) gets the
+  subnet 10.1.(c+1).0/24. Every non-root node sends to its parent.
+
+  Default (depth 2, fan-out 2):
+
+                        n0            Wifi 10.1.1.0
+                     /      \
+                   n1        n2       Wifi 10.1.2.0, 10.1.3.0
+                  /  \      /  \
+                 n3  n4    n5  n6
 */
 
 
@@ -155,6 +166,242 @@ SocketApp::ScheduleTx (void)
 
 
 
+// Streams the throughput, delay and losses of every flow over each sampling
+// interval to a CSV file while the simulation runs. Only the cumulative
+// counters of the previous sample are kept, one entry per flow.
+class FlowSampler
+{
+public:
+
+  FlowSampler (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+               std::string fileName, Time interval);
+  void Start (void);
+
+private:
+
+  void Sample (void);
+
+  struct Counters
+  {
+    uint64_t rxBytes;
+    uint32_t rxPackets;
+    uint32_t lostPackets;
+    Time delaySum;
+  };
+
+  Ptr<FlowMonitor>            m_monitor;
+  Ptr<Ipv4FlowClassifier>     m_classifier;
+  std::ofstream               m_out;
+  Time                        m_interval;
+  std::map<FlowId, Counters>  m_last;
+};
+
+FlowSampler::FlowSampler (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+                          std::string fileName, Time interval)
+  : m_monitor (monitor),
+    m_classifier (classifier),
+    m_out (fileName.c_str (), std::ios::out),
+    m_interval (interval)
+{
+  m_out << "time_s,flow_id,src,dst,throughput_mbps,mean_delay_ms,lost_packets\n";
+}
+
+void
+FlowSampler::Start (void)
+{
+  Simulator::Schedule (m_interval, &FlowSampler::Sample, this);
+}
+
+void
+FlowSampler::Sample (void)
+{
+  m_monitor->CheckForLostPackets ();
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+
+  for (FlowMonitor::FlowStatsContainerCI it = stats.begin (); it != stats.end (); it++)
+    {
+      Counters &last = m_last[it->first];   // zero initialized for a new flow
+      const FlowMonitor::FlowStats &cur = it->second;
+      Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow (it->first);
+
+      uint32_t rxPackets = cur.rxPackets - last.rxPackets;
+      double throughput = (cur.rxBytes - last.rxBytes) * 8.0 / m_interval.GetSeconds () / 1e6;
+      double delay = rxPackets ? (cur.delaySum - last.delaySum).GetSeconds () * 1e3 / rxPackets : 0.0;
+
+      m_out << Simulator::Now ().GetSeconds () << "," << it->first << ","
+            << t.sourceAddress << "," << t.destinationAddress << ","
+            << throughput << "," << delay << "," << cur.lostPackets - last.lostPackets << "\n";
+
+      last.rxBytes = cur.rxBytes;
+      last.rxPackets = cur.rxPackets;
+      last.lostPackets = cur.lostPackets;
+      last.delaySum = cur.delaySum;
+    }
+  m_out.flush ();
+
+  Simulator::Schedule (m_interval, &FlowSampler::Sample, this);
+}
+
+
+
+
+// Normalized weighted throughput: received bytes of every source node
+// divided by its SP, and Jain's fairness index over them. The sums the index
+// is made of are updated on every received packet, so it is available at
+// any time without a pass over the nodes.
+class FairnessMeter
+{
+public:
+
+  FairnessMeter ();
+  void AddSource (Ipv4Address address, uint32_t nodeId, int sp);
+  void Rx (Ptr<const Packet> packet, const Address &from);
+  double GetJainIndex (void) const;
+  void Write (std::string fileName) const;
+
+private:
+
+  struct Source
+  {
+    uint32_t nodeId;
+    int sp;
+    uint64_t rxBytes;
+    double normalized;   // rxBytes / sp
+  };
+
+  std::map<Ipv4Address, Source> m_sources;
+  double m_sum;          // sum of the normalized values
+  double m_sumSquares;   // sum of their squares
+  Time m_firstRx;
+};
+
+FairnessMeter::FairnessMeter ()
+  : m_sum (0),
+    m_sumSquares (0),
+    m_firstRx (Time::Max ())
+{
+}
+
+void
+FairnessMeter::AddSource (Ipv4Address address, uint32_t nodeId, int sp)
+{
+  Source source = {nodeId, sp, 0, 0.0};
+  m_sources.insert (std::make_pair (address, source));
+}
+
+void
+FairnessMeter::Rx (Ptr<const Packet> packet, const Address &from)
+{
+  std::map<Ipv4Address, Source>::iterator it = m_sources.find (InetSocketAddress::ConvertFrom (from).GetIpv4 ());
+  if (it == m_sources.end () || it->second.sp <= 0)
+    {
+      return;
+    }
+
+  Source &source = it->second;
+  double old = source.normalized;
+  source.rxBytes += packet->GetSize ();
+  source.normalized = source.rxBytes * 1.0 / source.sp;
+  m_sum += source.normalized - old;
+  m_sumSquares += source.normalized * source.normalized - old * old;
+  m_firstRx = std::min (m_firstRx, Simulator::Now ());
+}
+
+double
+FairnessMeter::GetJainIndex (void) const
+{
+  if (m_sources.empty () || m_sumSquares <= 0)
+    {
+      return 0.0;
+    }
+  return m_sum * m_sum / (m_sources.size () * m_sumSquares);
+}
+
+void
+FairnessMeter::Write (std::string fileName) const
+{
+  std::ofstream out (fileName.c_str (), std::ios::out);
+  double duration = (Simulator::Now () - m_firstRx).GetSeconds ();
+
+  out << "node,sp,throughput_mbps,normalized_throughput_mbps\n";
+  for (std::map<Ipv4Address, Source>::const_iterator it = m_sources.begin (); it != m_sources.end (); it++)
+    {
+      double throughput = duration > 0 ? it->second.rxBytes * 8.0 / duration / 1e6 : 0.0;
+      out << it->second.nodeId << "," << it->second.sp << ","
+          << throughput << "," << throughput / it->second.sp << "\n";
+    }
+}
+
+
+
+
+// Records the congestion degree (Ts / Ta) and scheduling rate of every node
+// as NetAnim node counters, every interval and only when they changed.
+class AnimStateRecorder
+{
+public:
+
+  AnimStateRecorder (AnimationInterface *anim, NodeContainer nodes, Time interval);
+  void Start (void);
+
+private:
+
+  void Record (void);
+
+  AnimationInterface   *m_anim;
+  NodeContainer         m_nodes;
+  Time                  m_interval;
+  uint32_t              m_degreeCounter;
+  uint32_t              m_rateCounter;
+  std::vector<double>   m_lastDegree;
+  std::vector<double>   m_lastRate;
+};
+
+AnimStateRecorder::AnimStateRecorder (AnimationInterface *anim, NodeContainer nodes, Time interval)
+  : m_anim (anim),
+    m_nodes (nodes),
+    m_interval (interval),
+    m_lastDegree (nodes.GetN (), -1.0),
+    m_lastRate (nodes.GetN (), -1.0)
+{
+  m_degreeCounter = m_anim->AddNodeCounter ("degree", AnimationInterface::DOUBLE_COUNTER);
+  m_rateCounter = m_anim->AddNodeCounter ("rate", AnimationInterface::DOUBLE_COUNTER);
+}
+
+void
+AnimStateRecorder::Start (void)
+{
+  Simulator::Schedule (m_interval, &AnimStateRecorder::Record, this);
+}
+
+void
+AnimStateRecorder::Record (void)
+{
+  for (uint32_t i = 0; i < m_nodes.GetN (); i++)
+    {
+      Ptr<Node> node = m_nodes.Get (i);
+      Ptr<NodeOption> option = node->GetNodeOption ();
+      double degree = option->GetTa () > 0 ? option->GetTs () / option->GetTa () : 0.0;
+      double rate = option->GetSvc ();
+
+      if (degree != m_lastDegree[i])
+        {
+          m_anim->UpdateNodeCounter (m_degreeCounter, node->GetId (), degree);
+          m_lastDegree[i] = degree;
+        }
+      if (rate != m_lastRate[i])
+        {
+          m_anim->UpdateNodeCounter (m_rateCounter, node->GetId (), rate);
+          m_lastRate[i] = rate;
+        }
+    }
+
+  Simulator::Schedule (m_interval, &AnimStateRecorder::Record, this);
+}
+
+
+
+
 class TcpApp : public Application 
 {
 public:
@@ -203,6 +450,23 @@ int coverageArea;
 uint32_t noOfNodes;
 int noOfNetworks;  
 
+int treeDepth;
+int fanOut;
+std::string spPerLevel;
+std::vector<int> levelSP;     // SP of the nodes of each level, root first
+
+NodeContainer treeNodes;      // all nodes, level by level
+
+std::string animMode;         // "full", "state" or "off"
+double animInterval;          // seconds between two state records
+
+double sampleInterval;        // seconds between two flow samples, 0 to disable
+std::string samplesFile;
+
+uint32_t rngSeed;
+uint32_t rngRun;
+int64_t nextStream;           // next RandomVariableStream index to assign
+
 NodeContainer* nodes;
 NodeContainer* apNodes;
 NetDeviceContainer* staDevices;
@@ -213,6 +477,8 @@ Ipv4InterfaceContainer* apInterfaces;
 ApplicationContainer sinkApps;
 ApplicationContainer serverApp;
 
+FairnessMeter fairness;
+
 
 
 
@@ -226,6 +492,7 @@ public:
   void setNoOfNodes(uint32_t nodes);
   void setNoOfFlows(int flows);
   void setNoOfNetworks(int networks);
+  void setTree(int depth, int fanOut, std::string sp);
   void setErrorModel(Ptr<NetDevice> destDevice);
 
   // int noOfFlows;
@@ -280,6 +547,51 @@ void TcpTest:: setNoOfNetworks(int networks){
 }
 
 
+// sizes the tree and parses the comma separated SP of each level; levels
+// past the end of the list reuse its last value
+void TcpTest:: setTree(int depth, int fan, std::string sp){
+  NS_ABORT_MSG_UNLESS (depth >= 1 && fan >= 1, "The tree needs depth >= 1 and fanOut >= 1");
+  NS_ABORT_MSG_IF (fan > 253, "A cell cannot hold more than 253 stations");
+
+  // sized in 64 bits, checked level by level before the next multiplication,
+  // since node and network counts are int / uint32_t
+  const uint64_t maxNodes = std::numeric_limits<int>::max();
+  uint64_t networks = 0;
+  uint64_t levelSize = 1;
+  uint64_t total = 1;
+  for(int d = 0; d < depth; d++){
+    networks += levelSize;
+    levelSize *= fan;
+    total += levelSize;
+    NS_ABORT_MSG_IF (total > maxNodes, "A tree of depth " << depth << " and fanOut " << fan
+                     << " has more than " << maxNodes << " nodes");
+  }
+
+  levelSP.clear();
+  std::stringstream ss(sp);
+  std::string item;
+  while(std::getline(ss, item, ',')){
+    // GP = SP + GP of the children travels in 16 bits
+    std::size_t end = 0;
+    long value = -1;
+    try{
+      value = std::stol(item, &end);
+    }
+    catch(const std::exception &){
+    }
+    NS_ABORT_MSG_IF (end != item.size() || value < 0 || value > 65535,
+                     "Invalid SP \"" << item << "\": expected an integer in [0, 65535]");
+    levelSP.push_back(value);
+  }
+  NS_ABORT_MSG_IF (levelSP.empty(), "No SP given for the tree levels");
+  while((int) levelSP.size() <= depth){
+    levelSP.push_back(levelSP.back());
+  }
+
+  setNoOfNodes(static_cast<uint32_t>(total));
+  setNoOfNetworks(static_cast<int>(networks));
+}
+
 bool TcpTest::Configure (int argc, char **argv, TcpApp tcpApp)
 {
   // Enable AODV logs by default. Comment this if too noisy
@@ -289,57 +601,68 @@ bool TcpTest::Configure (int argc, char **argv, TcpApp tcpApp)
   // LogComponentEnable("TrafficControlLayer", LOG_LEVEL_ALL);
   // LogComponentEnable("Ipv4Interface", LOG_LEVEL_ALL);
 
-  //SeedManager::SetSeed (12345);
   CommandLine cmd (__FILE__);
 
   cmd.AddValue ("simTime", "Simulation time in seconds", simulationTime);
   // cmd.AddValue("nNodes", "Number of nodes", noOfNodes);
   cmd.AddValue("nFlows", "Number of flows", noOfFlows);
   // cmd.AddValue("nPktsPerSec", "Number of packets per second", noOfPacketsPerSec);
-  // cmd.AddValue("coverage", "Coverage Area", coverageArea);
+  cmd.AddValue ("coverage", "Coverage area, in units of 20 m of Wi-Fi range", coverageArea);
+  cmd.AddValue ("depth", "Depth of the tree (root at depth 0)", treeDepth);
+  cmd.AddValue ("fanOut", "Number of children of every non-leaf node", fanOut);
+  cmd.AddValue ("sp", "Comma separated source traffic priority of each level, root first", spPerLevel);
+  cmd.AddValue ("anim", "NetAnim trace: full (every packet), state (positions, degree and rate only) or off", animMode);
+  cmd.AddValue ("animInterval", "Seconds between two degree/rate records of the state NetAnim trace", animInterval);
+  cmd.AddValue ("sampleInterval", "Seconds between two per-flow samples, 0 to disable", sampleInterval);
+  cmd.AddValue ("samplesFile", "CSV file of the per-flow samples", samplesFile);
+  cmd.AddValue ("seed", "Seed of the random number generator", rngSeed);
+  cmd.AddValue ("run", "Run (substream) of the random number generator", rngRun);
 
   cmd.Parse (argc, argv);
+
+  // identical seed and run give identical results
+  RngSeedManager::SetSeed (rngSeed);
+  RngSeedManager::SetRun (rngRun);
   return true;
 }
 
 void TcpTest::CreateNodes ()
 {
-  NodeContainer tempNodes;
-  tempNodes.Create(noOfNodes);
-
-  nodes[0].Add(tempNodes.Get(0));
-  nodes[0].Add(tempNodes.Get(1));
-  apNodes[0].Add(tempNodes.Get(4));
+  treeNodes.Create(noOfNodes);
 
-  nodes[1].Add(tempNodes.Get(2));
-  nodes[1].Add(tempNodes.Get(3));
-  apNodes[1].Add(tempNodes.Get(5));
-
-  nodes[2].Add(tempNodes.Get(4));
-  nodes[2].Add(tempNodes.Get(5));
-  apNodes[2].Add(tempNodes.Get(6));
+  // cell i: AP n_i, STAs its children
+  for(int i = 0; i < noOfNetworks; i++){
+    apNodes[i].Add(treeNodes.Get(i));
+    for(int j = 0; j < fanOut; j++){
+      nodes[i].Add(treeNodes.Get(i * fanOut + 1 + j));
+    }
+  }
 }
 
 
 void TcpTest::ApplyMobility(){
-  // Create static grid
+  // children on a circle around their parent, each cell having a channel
+  // of its own; the radius shrinks with the level to keep the layout legible
+  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+  std::vector<Vector> position(noOfNodes);
+  std::vector<double> radius(noOfNodes, 20.0);
+
+  position[0] = Vector(0.0, 0.0, 0.0);
+  for(uint32_t n = 1; n < noOfNodes; n++){
+    uint32_t parent = (n - 1) / fanOut;
+    radius[n] = std::max(radius[parent] / 2, 1.0);
+    double angle = 2 * M_PI * ((n - 1) % fanOut) / fanOut;
+    position[n] = Vector(position[parent].x + radius[n] * std::cos(angle),
+                         position[parent].y + radius[n] * std::sin(angle), 0.0);
+  }
+  for(uint32_t n = 0; n < noOfNodes; n++){
+    positionAlloc->Add(position[n]);
+  }
+
   MobilityHelper mobility;
-  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                "MinX", DoubleValue (0.0),
-                                "MinY", DoubleValue (0.0),
-                                "DeltaX", DoubleValue (5.0),
-                                "DeltaY", DoubleValue (5.0),
-                                "GridWidth", UintegerValue (3),
-                                "LayoutType", StringValue ("RowFirst"));
-                                
-  
+  mobility.SetPositionAllocator (positionAlloc);
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-
-  for(int i = 0; i < noOfNetworks; i++){
-    mobility.Install (nodes[i].Get(0));
-    mobility.Install (apNodes[i].Get(0));
-    mobility.Install (nodes[i].Get(1));
-  }    
+  mobility.Install (treeNodes);
 }
 
 void
@@ -388,6 +711,11 @@ TcpTest::CreateDevices(TcpApp tcpApp)
       /* Configure STA */
       wifiMacHelper.SetType ("ns3::StaWifiMac", "Ssid", SsidValue (ssid[i]));
       staDevices[i] = wifiHelper.Install (wifiPhyHelper[i], wifiMacHelper, nodes[i]); 
+
+      // fixed stream indices, so that a change in one cell does not shift the
+      // random numbers drawn by the others
+      nextStream += wifiHelper.AssignStreams (apDevices[i], nextStream);
+      nextStream += wifiHelper.AssignStreams (staDevices[i], nextStream);
   }
 
 }
@@ -399,19 +727,24 @@ TcpTest::InstallInternetStack ()
 
   Ipv4AddressHelper address;
 
-  stack.Install(apNodes[2]);
+  stack.Install(treeNodes);
+  nextStream += stack.AssignStreams(treeNodes, nextStream);
 
+  // upstream traffic of every station is paced by PCCP; install before the
+  // addresses are assigned so that no default queue disc takes its place
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::PccpQueueDisc");
   for(int i = 0; i < noOfNetworks; i++){
-      stack.Install (nodes[i]);
+    tch.Install (staDevices[i]);
   }
 
+  // 10.1.1.0, 10.1.2.0, ..., 10.1.255.0, 10.2.0.0, ...
+  address.SetBase ("10.1.1.0", "255.255.255.0");
   for(int i = 0; i < noOfNetworks; i++){
 
-    std::string ip = "10.1." + std::to_string((i + 1)) +".0";
-    address.SetBase (ip.c_str(), "255.255.255.0");
-
     apInterfaces[i] = address.Assign(apDevices[i]);
     staInterfaces[i] = address.Assign(staDevices[i]);
+    address.NewNetwork();
 
   }
 }
@@ -419,169 +752,71 @@ TcpTest::InstallInternetStack ()
 void
 InstallApplications(int fl)
 {
+  // every STA of every cell sends to the AP of the cell, i.e. its parent
+  for(int i = 0; i < noOfNetworks; i++){
+    for(int j = 0; j < fanOut; j++){
 
-  //for(int k = 0; k < 6; k++){
-
-
-    for(int i = 0; i < 1; i++){
-
-      for(int k = 0; k < 6; k++){
-        // if(k == 2){
-        //   continue;
-        // }
-
-        Ipv4Address addr;
-        Ptr<Node> destNode;
-        Ptr<Node> srcNode;
-
-        if(k == 0){
-          addr = apInterfaces[0].GetAddress(0);
-          destNode = apNodes[0].Get(0);
-          srcNode = nodes[0].Get(0);       
-        }
-        else if(k == 1){
-          addr = apInterfaces[0].GetAddress(0);
-          destNode = apNodes[0].Get(0);
-          srcNode = nodes[0].Get(1);
-        }
-        else if(k == 2){
-          addr = apInterfaces[1].GetAddress(0);
-          destNode = apNodes[1].Get(0);
-          srcNode = nodes[1].Get(0);
-        }        
-        else if(k == 3){
-          addr = apInterfaces[1].GetAddress(0);
-          destNode = apNodes[1].Get(0);
-          srcNode = nodes[1].Get(1);
-        }
-        else if(k == 4){
-          addr = apInterfaces[2].GetAddress(0);
-          destNode = apNodes[2].Get(0);
-          srcNode = nodes[2].Get(0);
-        }
-        else if(k == 5){
-          addr = apInterfaces[2].GetAddress(0);
-          destNode = apNodes[2].Get(0);
-          srcNode = nodes[2].Get(1);
-        }    
-
-        srcNode->SetPrevNode(destNode);
-        destNode->SetPrevNode(srcNode);
-
-        if(i == 0){
-          int curOffsprings = destNode->GetNodeOption()->GetOffsprings();
-          destNode->GetNodeOption()->SetOffsprings(curOffsprings + 1);
-        }
-
-
-        uint16_t sinkPort = 1000*fl + k;
-
-        Address sinkAddress (InetSocketAddress (addr, sinkPort));
-        PacketSinkHelper packetSinkHelper("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny(), sinkPort));
-        sinkApps = packetSinkHelper.Install(destNode);
+      Ipv4Address addr = apInterfaces[i].GetAddress(0);
+      Ptr<Node> destNode = apNodes[i].Get(0);
+      Ptr<Node> srcNode = nodes[i].Get(j);
 
-        // packetSinkVec[i] = StaticCast<PacketSink>(sinkApps.Get(0));
+      // unique on the destination node
+      uint16_t sinkPort = 1000 + fl * fanOut + j;
 
-        sinkApps.Start (Seconds (0.0));
+      Address sinkAddress (InetSocketAddress (addr, sinkPort));
+      PacketSinkHelper packetSinkHelper("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny(), sinkPort));
+      sinkApps = packetSinkHelper.Install(destNode);
+      sinkApps.Get(0)->TraceConnectWithoutContext("Rx", MakeCallback(&FairnessMeter::Rx, &fairness));
 
-        Ptr<Socket> ns3TcpSocket = Socket::CreateSocket (srcNode, TcpSocketFactory::GetTypeId ());
-        Ptr<SocketApp> socketApp = CreateObject<SocketApp> ();
+      sinkApps.Start (Seconds (0.0));
 
-        std::string dataRate = std::to_string(noOfPacketsPerSec * 1500 * 8);
-        socketApp->Setup (ns3TcpSocket, sinkAddress, 1500, 1000, DataRate (dataRate));
-        srcNode->AddApplication(socketApp);
+      Ptr<Socket> ns3TcpSocket = Socket::CreateSocket (srcNode, TcpSocketFactory::GetTypeId ());
+      Ptr<SocketApp> socketApp = CreateObject<SocketApp> ();
 
-        socketApp->SetStartTime (Seconds (1.0));
+      std::string dataRate = std::to_string(noOfPacketsPerSec * 1500 * 8);
+      socketApp->Setup (ns3TcpSocket, sinkAddress, 1500, 1000, DataRate (dataRate));
+      srcNode->AddApplication(socketApp);
 
-    
-      }
-
-      // sleep(1);
+      socketApp->SetStartTime (Seconds (1.0));
 
     }
-
-  //}
+  }
 }
 
 
 void TcpTest::SetNodeOptions(){
-  std::vector<Ptr<Node>> nodeVec;
-  nodeVec.resize(noOfNodes);
-
-  std::vector<Ptr<NodeOption>> optionVec;
-  optionVec.resize(noOfNodes);
-
-  for(int i = 0; i < noOfNetworks; i++){
-    for(int j = 0; j < 2; j++){
-      nodeVec[2*i+j] = nodes[i].Get(j);
-      nodeVec[2*i+j]->SetPrevNode(apNodes[i].Get(0));
-    }
-  }
-
-  nodeVec[6] = apNodes[2].Get(0);
-  //nodeVec[6]->SetPrevNode
-
-  // set options
-  for(int i = 0; i < (int) noOfNodes; i++){
-    optionVec[i] = CreateObject<NodeOption>();
-    nodeVec[i]->SetNodeOption(optionVec[i]);
-  }
-
-  // set attributes
-  for(int i = 0; i < noOfNetworks; i++){
-    for(int j = 0; j < 2; j++){
-
-      optionVec[2*i+j]->SetPktFactor(10);
-      optionVec[2*i+j]->SetPktsSinceLastICD(0);
-      optionVec[2*i+j]->SetTa(0.1);
-      optionVec[2*i+j]->SetTs(0.1);
-      optionVec[2*i+j]->SetSP(2*i + j + 2);
-      optionVec[2*i+j]->SetGP(2*i + j + 2);
-      optionVec[2*i+j]->SetParentOffsprings(0);
-      optionVec[2*i+j]->SetSvc(10);
-      optionVec[2*i+j]->SetParentDegree(1.0);
-      optionVec[2*i+j]->SetParentAddress(apInterfaces[i].GetAddress(0));
-      staDevices[i].Get(j)->ipAddr = apInterfaces[i].GetAddress(0);
-      
-    }
-  }
-
-  optionVec[6]->SetPktsSinceLastICD(0);
-  optionVec[6]->SetTs(0.1);
-  optionVec[6]->SetTa(0.1);
-  optionVec[6]->SetSP(10);
-  optionVec[6]->SetGP(10);
-  optionVec[6]->SetOffsprings(0);   // active offsprings 
-  optionVec[6]->SetParentAddress(apInterfaces[2].GetAddress(0));  
+  std::vector<int> level(noOfNodes, 0);
 
+  for(uint32_t n = 0; n < noOfNodes; n++){
+    Ptr<Node> node = treeNodes.Get(n);
+    Ptr<NodeOption> option = CreateObject<NodeOption>();
+    node->SetNodeOption(option);
 
-  // set parent node
-  for(int i = 0; i < noOfNetworks; i++){
-    for(int j = 0; j < 2; j++){
-        nodeVec[2*i+j]->SetParentNode(apNodes[i].Get(0));
+    if(n > 0){
+      level[n] = level[(n - 1) / fanOut] + 1;
     }
-  }
-
-  int globalParentGP = 10;
-  // calculate GP for parent nodes
-  for(int i = 0; i < noOfNetworks - 1; i++){
-    int gp = apNodes[i].Get(0)->GetNodeOption()->GetSP();
-
-    for(int j = 0; j < 2; j++){
-      gp += nodes[i].Get(0)->GetNodeOption()->GetSP();
+    option->SetSP(levelSP[level[n]]);
+    option->SetGP(option->GetSP());   // children add theirs when active
+    option->SetPktsSinceLastICD(0);
+    option->SetOffsprings(0);   // active offsprings
+
+    if(n == 0){
+      // the root is the AP of cell 0
+      option->SetParentAddress(apInterfaces[0].GetAddress(0));
+      continue;
     }
 
-    apNodes[i].Get(0)->GetNodeOption()->SetGP(gp);
-    // active offsprings
-    //apNodes[i].Get(0)->GetNodeOption()->SetOffsprings(1);
-    apNodes[i].Get(0)->GetNodeOption()->SetOffsprings(0);
-
-    globalParentGP += gp;     
+    int cell = (n - 1) / fanOut;
+    int j = (n - 1) % fanOut;
+    option->SetPktFactor(10);
+    NodeOption::SetNodeIdle(node, true);   // counted in the parent GP once it sends
+    option->SetParentOffsprings(0);
+    option->SetParentDegree(1.0);
+    option->SetParentAddress(apInterfaces[cell].GetAddress(0));
+    staDevices[cell].Get(j)->ipAddr = apInterfaces[cell].GetAddress(0);
+    fairness.AddSource(staInterfaces[cell].GetAddress(j), node->GetId(), option->GetSP());
+    NodeOption::AttachNode(node, apNodes[cell].Get(0));
   }
-
-  optionVec[6]->SetGP(globalParentGP);
-  optionVec[6]->SetOffsprings(0);
-
 }
 
 
@@ -613,34 +848,75 @@ void TcpTest::Run(TcpApp tcpApp)
   //   Simulator::Schedule (Seconds (1.1), &CalculateThroughput, i);
   // }
 
-  std::cout << "Starting simulation for " << simulationTime << " s ...\n";
+  std::cout << "Starting simulation for " << simulationTime << " s (seed " << rngSeed
+            << ", run " << rngRun << ") ...\n";
 
   // Flow monitor
   Ptr<FlowMonitor> flowMonitor;
   FlowMonitorHelper flowHelper;
   flowMonitor = flowHelper.InstallAll();
 
+  std::unique_ptr<FlowSampler> sampler;
+  if(sampleInterval > 0){
+    sampler.reset(new FlowSampler(flowMonitor, DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier()),
+                                  samplesFile, Seconds(sampleInterval)));
+    sampler->Start();
+  }
+
   Simulator::Stop (Seconds (simulationTime + 1));
 
-  AnimationInterface anim("test.xml");
+  NS_ABORT_MSG_UNLESS (animMode == "full" || animMode == "state" || animMode == "off",
+                       "Unknown NetAnim mode " << animMode);
+  std::unique_ptr<AnimationInterface> anim;
+  std::unique_ptr<AnimStateRecorder> animState;
+  if(animMode != "off"){
+    anim.reset(new AnimationInterface("test.xml"));
+  }
+  if(animMode == "state"){
+    anim->SkipPacketTracing();
+    animState.reset(new AnimStateRecorder(anim.get(), treeNodes, Seconds(animInterval)));
+    animState->Start();
+  }
 
   Simulator::Run ();
 
-  flowMonitor->SerializeToXmlFile("flow.xml", true, true);
+  // summary only: the time series are in the samples file
+  flowMonitor->SerializeToXmlFile("flow.xml", false, false);
+
+  // cost of piggybacking the congestion state on every packet
+  uint64_t signalingBytes = 0;
+  for(NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); it++){
+    Ptr<TrafficControlLayer> tc = (*it)->GetObject<TrafficControlLayer>();
+    if(tc){
+      signalingBytes += tc->GetSignalingTxBytes();
+    }
+  }
+  std::cout << "PCCP signaling overhead: " << signalingBytes << " bytes\n";
+
+  fairness.Write("fairness.csv");
+  std::cout << "Jain's fairness index of throughput/SP: " << fairness.GetJainIndex() << "\n";
 }
 
 
 int main (int argc, char **argv)
 {
-  srand(time(0));
   TcpTest test;
   TcpApp tcpApp;
 
   LogComponentEnable ("PacketSink", LOG_LEVEL_INFO);
 
   simulationTime = 30;
-  test.setNoOfNodes(7);
   test.setNoOfFlows(50);
+  treeDepth = 2;
+  fanOut = 2;
+  spPerLevel = "10,6,2";
+  animMode = "full";
+  animInterval = 0.5;
+  sampleInterval = 0.5;
+  samplesFile = "flow-samples.csv";
+  rngSeed = 1;
+  rngRun = 1;
+  nextStream = 0;
   noOfPacketsPerSec = 300;
   coverageArea = 1;
 
@@ -648,7 +924,7 @@ int main (int argc, char **argv)
     NS_FATAL_ERROR ("Configuration failed. Aborted.");
 
 
-  test.setNoOfNetworks(3);
+  test.setTree(treeDepth, fanOut, spPerLevel);
   tcpApp.tcpVariant = "TcpNewReno";
 
   // packetSinkVec.resize(test.noOfFlows/2);
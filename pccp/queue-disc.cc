@@ -29,6 +29,8 @@
 #include "queue-disc.h"
 #include "ns3/net-device-queue-interface.h"
 #include "ns3/queue.h"
+#include "ns3/drop-tail-queue.h"
+#include "traffic-control-layer.h"
 
 namespace ns3 {
 
@@ -1127,6 +1129,247 @@ bool QueueDisc::IsQDiscRunning(void) const{
   return isTransmitted;
 }
 
+
+NS_OBJECT_ENSURE_REGISTERED (PccpTransitTag);
+
+TypeId
+PccpTransitTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpTransitTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<PccpTransitTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+PccpTransitTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+PccpTransitTag::GetSerializedSize (void) const
+{
+  return 0;
+}
+
+void
+PccpTransitTag::Serialize (TagBuffer i) const
+{
+}
+
+void
+PccpTransitTag::Deserialize (TagBuffer i)
+{
+}
+
+void
+PccpTransitTag::Print (std::ostream &os) const
+{
+  os << "transit";
+}
+
+
+NS_OBJECT_ENSURE_REGISTERED (PccpQueueDisc);
+
+TypeId PccpQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpQueueDisc")
+    .SetParent<QueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<PccpQueueDisc> ()
+    .AddAttribute ("MaxSize",
+                   "The max queue size, in packets or bytes",
+                   QueueSizeValue (QueueSize ("1000p")),
+                   MakeQueueSizeAccessor (&QueueDisc::SetMaxSize,
+                                          &QueueDisc::GetMaxSize),
+                   MakeQueueSizeChecker ())
+    .AddTraceSource ("PccpEnqueue",
+                     "Packet held back by the pacing: queued behind other packets, "
+                     "or arriving less than a pacing interval after the last departure",
+                     MakeTraceSourceAccessor (&PccpQueueDisc::m_tracePccpEnqueue),
+                     "ns3::QueueDiscItem::TracedCallback")
+  ;
+  return tid;
+}
+
+PccpQueueDisc::PccpQueueDisc ()
+  : QueueDisc (QueueDiscSizePolicy::MULTIPLE_QUEUES),
+    m_pacingInterval (Seconds (0)),
+    m_lastDeparture (Time::Min ()),
+    m_sourceShare (1.0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PccpQueueDisc::~PccpQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+PccpQueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_id);
+  QueueDisc::DoDispose ();
+}
+
+void
+PccpQueueDisc::SetPacingInterval (Time interval)
+{
+  NS_LOG_FUNCTION (this << interval);
+  m_pacingInterval = interval;
+}
+
+Time
+PccpQueueDisc::GetPacingInterval (void) const
+{
+  return m_pacingInterval;
+}
+
+void
+PccpQueueDisc::SetSourceShare (double share)
+{
+  NS_LOG_FUNCTION (this << share);
+  NS_ASSERT (share >= 0.0 && share <= 1.0);
+  m_sourceShare = share;
+}
+
+bool
+PccpQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+
+  PccpTransitTag tag;
+  bool transit = item->GetPacket ()->PeekPacketTag (tag);
+  Ptr<InternalQueue> sourceQueue = GetInternalQueue (SOURCE_QUEUE);
+
+  if (!transit && GetCurrentSize () + item > GetMaxSize ())
+    {
+      NS_LOG_LOGIC ("Queue full -- dropping source pkt");
+      DropBeforeEnqueue (item, SOURCE_LIMIT_DROP);
+      return false;
+    }
+
+  // make room for transit traffic by evicting the oldest source packets, as
+  // long as source traffic holds more than its share
+  double sourceLimit = m_sourceShare * GetMaxSize ().GetValue ();
+  while (transit && GetCurrentSize () + item > GetMaxSize ()
+         && !sourceQueue->IsEmpty ()
+         && sourceQueue->GetCurrentSize ().GetValue () > sourceLimit)
+    {
+      Ptr<QueueDiscItem> evicted = sourceQueue->Dequeue ();
+      NS_LOG_LOGIC ("Queue full -- evicting source pkt " << evicted);
+      DropAfterDequeue (evicted, SOURCE_EVICT_DROP);
+    }
+
+  if (GetCurrentSize () + item > GetMaxSize ())
+    {
+      NS_LOG_LOGIC ("Queue full -- dropping transit pkt");
+      DropBeforeEnqueue (item, TRANSIT_LIMIT_DROP);
+      return false;
+    }
+
+  // with pacing, the packet cannot leave right away if others are waiting
+  // or the last departure is too recent
+  bool held = m_pacingInterval.IsStrictlyPositive ()
+    && (GetNPackets () > 0 || Simulator::Now () < m_lastDeparture + m_pacingInterval);
+
+  bool retval = GetInternalQueue (transit ? TRANSIT_QUEUE : SOURCE_QUEUE)->Enqueue (item);
+
+  if (retval && held)
+    {
+      PCCP_TRACE (m_tracePccpEnqueue, item);
+    }
+
+  // If Queue::Enqueue fails, QueueDisc::DropBeforeEnqueue is called by the
+  // internal queue because QueueDisc::AddInternalQueue sets the trace callback
+
+  NS_LOG_LOGIC ("Number packets " << GetNPackets ());
+  NS_LOG_LOGIC ("Number bytes " << GetNBytes ());
+
+  return retval;
+}
+
+Ptr<QueueDiscItem>
+PccpQueueDisc::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<const QueueDiscItem> source = GetInternalQueue (SOURCE_QUEUE)->Peek ();
+  Ptr<const QueueDiscItem> transit = GetInternalQueue (TRANSIT_QUEUE)->Peek ();
+
+  if (!source && !transit)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+
+  Time now = Simulator::Now ();
+  Time nextDeparture = m_lastDeparture + m_pacingInterval;
+
+  if (m_pacingInterval.IsStrictlyPositive () && now < nextDeparture)
+    {
+      // wake up when the next packet is allowed to leave; a pending wake-up
+      // scheduled with an older pacing interval is moved accordingly
+      Simulator::Cancel (m_id);
+      m_id = Simulator::Schedule (nextDeparture - now, &QueueDisc::Run, this);
+      NS_LOG_LOGIC ("Pacing: next departure at " << nextDeparture);
+      return 0;
+    }
+
+  // serve the two internal queues in arrival order
+  bool fromTransit = transit && (!source || transit->GetTimeStamp () < source->GetTimeStamp ());
+  Ptr<QueueDiscItem> item = GetInternalQueue (fromTransit ? TRANSIT_QUEUE : SOURCE_QUEUE)->Dequeue ();
+  m_lastDeparture = now;
+
+  return item;
+}
+
+bool
+PccpQueueDisc::CheckConfig (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (GetNQueueDiscClasses () > 0)
+    {
+      NS_LOG_ERROR ("PccpQueueDisc cannot have classes");
+      return false;
+    }
+
+  if (GetNPacketFilters () > 0)
+    {
+      NS_LOG_ERROR ("PccpQueueDisc needs no packet filter");
+      return false;
+    }
+
+  if (GetNInternalQueues () == 0)
+    {
+      // add the source and the transit DropTail queues; the limit is enforced
+      // by the queue disc as a whole
+      AddInternalQueue (CreateObjectWithAttributes<DropTailQueue<QueueDiscItem> >
+                          ("MaxSize", QueueSizeValue (GetMaxSize ())));
+      AddInternalQueue (CreateObjectWithAttributes<DropTailQueue<QueueDiscItem> >
+                          ("MaxSize", QueueSizeValue (GetMaxSize ())));
+    }
+
+  if (GetNInternalQueues () != 2)
+    {
+      NS_LOG_ERROR ("PccpQueueDisc needs 2 internal queues");
+      return false;
+    }
+
+  return true;
+}
+
+void
+PccpQueueDisc::InitializeParams (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
 /*--------------------------- my changes ends ---------------------------*/
 
 
@@ -25,6 +25,9 @@
 #include "ns3/traced-callback.h"
 #include "ns3/queue-item.h"
 #include "ns3/queue-size.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/tag.h"
 #include <vector>
 #include <map>
 #include <functional>
@@ -767,6 +770,114 @@ private:
  */
 std::ostream& operator<< (std::ostream& os, const QueueDisc::Stats &stats);
 
+
+/*--------------------------- my changes starts ---------------------------*/
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Packet tag marking a packet received from a child node, i.e. transit
+ *        traffic for the next upstream hop.
+ *
+ * Added by TrafficControlLayer::Receive; packets without it are source
+ * traffic of the node sending them.
+ */
+class PccpTransitTag : public Tag
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+};
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Bounded FIFO queue disc that releases packets no faster than the
+ *        PCCP source rate of the node.
+ *
+ * Installed as root queue disc on the upstream device of a node (e.g. via
+ * TrafficControlHelper). The TrafficControlLayer sets the pacing interval
+ * derived from SrcRate () whenever the parent is congested, and resets it to
+ * zero otherwise. While the interval is non-zero, DoDequeue refuses to release
+ * a packet before the next departure time and schedules a Run at that time,
+ * so the backlog keeps draining at the source rate even when no new packet
+ * arrives.
+ *
+ * Source traffic of the node and transit traffic of its children (see
+ * PccpTransitTag) are stored in two internal queues and dequeued in arrival
+ * order. When the queue disc is full, source traffic is dropped first: an
+ * arriving source packet is dropped, and an arriving transit packet evicts the
+ * oldest source packet as long as source traffic holds more than its SP / GP
+ * share of MaxSize.
+ */
+class PccpQueueDisc : public QueueDisc {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief PccpQueueDisc constructor
+   */
+  PccpQueueDisc ();
+
+  virtual ~PccpQueueDisc ();
+
+  /**
+   * \brief Set the minimum time between two departures
+   * \param interval the pacing interval, zero to disable pacing
+   */
+  void SetPacingInterval (Time interval);
+  /**
+   * \return the current pacing interval
+   */
+  Time GetPacingInterval (void) const;
+  /**
+   * \brief Set the share of MaxSize reserved to source traffic
+   * \param share the SP / GP ratio of the node, in [0, 1]
+   */
+  void SetSourceShare (double share);
+
+  // Reasons for dropping packets
+  static constexpr const char* SOURCE_LIMIT_DROP = "Source traffic over limit";      //!< Arriving source packet dropped, queue disc full
+  static constexpr const char* TRANSIT_LIMIT_DROP = "Transit traffic over limit";    //!< Arriving transit packet dropped, queue disc full
+  static constexpr const char* SOURCE_EVICT_DROP = "Source traffic evicted";          //!< Queued source packet dropped to admit transit traffic
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> DoDequeue (void);
+  virtual bool CheckConfig (void);
+  virtual void InitializeParams (void);
+
+  /// Index of the internal queues
+  enum
+  {
+    SOURCE_QUEUE = 0,
+    TRANSIT_QUEUE = 1
+  };
+
+  Time m_pacingInterval;   //!< minimum time between two departures
+  Time m_lastDeparture;    //!< time the last packet left the queue disc
+  EventId m_id;            //!< EventId of the scheduled queue waking event
+  double m_sourceShare;    //!< share of MaxSize reserved to source traffic
+
+  TracedCallback<Ptr<const QueueDiscItem> > m_tracePccpEnqueue; //!< packet held back by the pacing
+};
+
+/*--------------------------- my changes ends ---------------------------*/
+
 } // namespace ns3
 
 #endif /* QueueDisc */
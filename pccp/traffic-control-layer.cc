@@ -25,8 +25,13 @@
 #include "ns3/socket.h"
 #include "ns3/queue-disc.h"
 #include <tuple>
+#include <algorithm>
 #include "ns3/core-module.h"
 #include "ns3/address.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/double.h"
+#include "ns3/channel.h"
+#include "ns3/pccp-header.h"
 
 namespace ns3 {
 
@@ -34,6 +39,84 @@ NS_LOG_COMPONENT_DEFINE ("TrafficControlLayer");
 
 NS_OBJECT_ENSURE_REGISTERED (TrafficControlLayer);
 
+/*--------------------------- my changes starts ---------------------------*/
+
+NS_OBJECT_ENSURE_REGISTERED (PccpTimestampTag);
+
+PccpTimestampTag::PccpTimestampTag ()
+  : m_nodeId (0)
+{
+}
+
+TypeId
+PccpTimestampTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PccpTimestampTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<PccpTimestampTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+PccpTimestampTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+PccpTimestampTag::GetSerializedSize (void) const
+{
+  return 12;
+}
+
+void
+PccpTimestampTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (m_time.GetTimeStep ());
+  i.WriteU32 (m_nodeId);
+}
+
+void
+PccpTimestampTag::Deserialize (TagBuffer i)
+{
+  m_time = TimeStep (i.ReadU64 ());
+  m_nodeId = i.ReadU32 ();
+}
+
+void
+PccpTimestampTag::Print (std::ostream &os) const
+{
+  os << "node=" << m_nodeId << " entry=" << m_time;
+}
+
+void
+PccpTimestampTag::SetTime (Time time)
+{
+  m_time = time;
+}
+
+Time
+PccpTimestampTag::GetTime (void) const
+{
+  return m_time;
+}
+
+void
+PccpTimestampTag::SetNodeId (uint32_t nodeId)
+{
+  m_nodeId = nodeId;
+}
+
+uint32_t
+PccpTimestampTag::GetNodeId (void) const
+{
+  return m_nodeId;
+}
+
+/*--------------------------- my changes ends ---------------------------*/
+
 TypeId
 TrafficControlLayer::GetTypeId (void)
 {
@@ -46,6 +129,43 @@ TrafficControlLayer::GetTypeId (void)
                    MakeObjectMapAccessor (&TrafficControlLayer::GetNDevices,
                                           &TrafficControlLayer::GetRootQueueDiscOnDeviceByIndex),
                    MakeObjectMapChecker<QueueDisc> ())
+
+    /*--------------------------- my changes starts ---------------------------*/
+
+    .AddAttribute ("CongestionThreshold",
+                   "Congestion degree of the parent from which upstream traffic is paced",
+                   DoubleValue (3.0),
+                   MakeDoubleAccessor (&TrafficControlLayer::m_congestionThreshold),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("SafetyFactor",
+                   "Fraction of the computed scheduling rate actually used",
+                   DoubleValue (0.98),
+                   MakeDoubleAccessor (&TrafficControlLayer::m_safetyFactor),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("IdleTimeout",
+                   "Time without traffic from a child after which it is no longer counted as an active offspring",
+                   TimeValue (Seconds (1.0)),
+                   MakeTimeAccessor (&TrafficControlLayer::m_idleTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("ControlInterval",
+                   "Period of the rate control epochs; 0 starts an epoch at every PccpHeader received from the parent",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&TrafficControlLayer::m_controlInterval),
+                   MakeTimeChecker (Seconds (0)))
+    .AddTraceSource ("TaUpdated",
+                     "Mean packet inter-arrival time of this node updated",
+                     MakeTraceSourceAccessor (&TrafficControlLayer::m_traceTaUpdated),
+                     "ns3::TracedValueCallback::Double")
+    .AddTraceSource ("TsUpdated",
+                     "Mean packet service time of this node updated",
+                     MakeTraceSourceAccessor (&TrafficControlLayer::m_traceTsUpdated),
+                     "ns3::TracedValueCallback::Double")
+    .AddTraceSource ("RateComputed",
+                     "Parent congestion degree and source rate computed at a rate control epoch",
+                     MakeTraceSourceAccessor (&TrafficControlLayer::m_traceRateComputed),
+                     "ns3::TrafficControlLayer::RateTracedCallback")
+
+    /*--------------------------- my changes ends ---------------------------*/
   ;
   return tid;
 }
@@ -57,7 +177,9 @@ TrafficControlLayer::GetInstanceTypeId (void) const
 }
 
 TrafficControlLayer::TrafficControlLayer ()
-  : Object ()
+  : Object (),
+    m_signalingTxBytes (0),
+    m_signalingRxBytes (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -73,7 +195,16 @@ TrafficControlLayer::DoDispose (void)
   NS_LOG_FUNCTION (this);
   m_node = 0;
   m_handlers.clear ();
+  m_dispatch.clear ();
   m_netDevices.clear ();
+  m_netDevicesByIfIndex.clear ();
+  for (auto& child : m_children)
+    {
+      child.second.idleEvent.Cancel ();
+    }
+  m_children.clear ();
+  m_controlEvent.Cancel ();
+  m_upstreamDevice = 0;
   Object::DoDispose ();
 }
 
@@ -84,6 +215,34 @@ TrafficControlLayer::DoInitialize (void)
 
   ScanDevices ();
 
+  /*--------------------------- my changes starts ---------------------------*/
+
+  // packets carrying a PccpHeader are handed to this layer, which strips the
+  // header and passes them up with their original protocol number
+  for (uint32_t i = 0; i < m_node->GetNDevices (); i++)
+    {
+      Ptr<NetDevice> dev = m_node->GetDevice (i);
+      m_node->RegisterProtocolHandler (MakeCallback (&TrafficControlLayer::Receive, this),
+                                       PccpHeader::PROT_NUMBER, dev);
+
+      // the service time of a packet ends when the PHY has transmitted it;
+      // the trace lives on the device or on its "Phy" (e.g. WifiNetDevice)
+      bool connected = dev->TraceConnectWithoutContext ("PhyTxEnd",
+                                                        MakeCallback (&TrafficControlLayer::NotifyTxEnd, this));
+      PointerValue phy;
+      if (!connected && dev->GetAttributeFailSafe ("Phy", phy) && phy.GetObject ())
+        {
+          connected = phy.GetObject ()->TraceConnectWithoutContext ("PhyTxEnd",
+                                                                    MakeCallback (&TrafficControlLayer::NotifyTxEnd, this));
+        }
+      if (!connected)
+        {
+          NS_LOG_WARN ("No PhyTxEnd trace on device " << dev << ", service time not measured");
+        }
+    }
+
+  /*--------------------------- my changes ends ---------------------------*/
+
   // initialize the root queue discs
   for (auto& ndi : m_netDevices)
     {
@@ -109,6 +268,7 @@ TrafficControlLayer::RegisterProtocolHandler (Node::ProtocolHandler handler,
   entry.promiscuous = false;
 
   m_handlers.push_back (entry);
+  m_dispatch.clear ();
 
   NS_LOG_DEBUG ("Handler for NetDevice: " << device << " registered for protocol " <<
                 protocolType << ".");
@@ -149,6 +309,7 @@ TrafficControlLayer::ScanDevices (void)
           NS_LOG_DEBUG ("No device entry found; create entry for device and store pointer to NetDeviceQueueInterface: " << ndqi);
           m_netDevices[dev] = {nullptr, ndqi, QueueDiscVector ()};
           ndi = m_netDevices.find (dev);
+          IndexNetDevice (dev, true);
         }
 
       // if a queue disc is installed, set the wake callbacks on netdevice queues
@@ -193,8 +354,8 @@ TrafficControlLayer::ScanDevices (void)
           for (auto& q : ndi->second.m_queueDiscsToWake)
             {
               q->SetNetDeviceQueueInterface (ndqi);
-              q->SetSendCallback ([dev] (Ptr<QueueDiscItem> item)
-                                  { dev->Send (item->GetPacket (), item->GetAddress (), item->GetProtocol ()); });
+              q->SetSendCallback ([this, dev] (Ptr<QueueDiscItem> item)
+                                  { PccpDeviceSend (dev, item); });
             }
         }
     }
@@ -211,6 +372,7 @@ TrafficControlLayer::SetRootQueueDiscOnDevice (Ptr<NetDevice> device, Ptr<QueueD
     {
       // No entry found for this device. Create one.
       m_netDevices[device] = {qDisc, nullptr, QueueDiscVector ()};
+      IndexNetDevice (device, true);
     }
   else
     {
@@ -227,13 +389,13 @@ TrafficControlLayer::GetRootQueueDiscOnDevice (Ptr<NetDevice> device) const
 {
   NS_LOG_FUNCTION (this << device);
 
-  std::map<Ptr<NetDevice>, NetDeviceInfo>::const_iterator ndi = m_netDevices.find (device);
+  const NetDeviceInfo *ndi = LookupNetDeviceInfo (device);
 
-  if (ndi == m_netDevices.end ())
+  if (!ndi)
     {
       return 0;
     }
-  return ndi->second.m_rootQueueDisc;
+  return ndi->m_rootQueueDisc;
 }
 
 Ptr<QueueDisc>
@@ -274,6 +436,7 @@ TrafficControlLayer::DeleteRootQueueDiscOnDevice (Ptr<NetDevice> device)
   else
     {
       // remove the empty entry
+      IndexNetDevice (device, false);
       m_netDevices.erase (ndi);
     }
 }
@@ -319,46 +482,72 @@ TrafficControlLayer::Receive (Ptr<NetDevice> device, Ptr<const Packet> p,
 
   /*--------------------------- my changes starts ---------------------------*/
 
-  std::cout<<"node="<<m_node->GetId()
-          << ": receive traffic: from:"<< from<<"," << m_node->GetNodeOption()->GetParentAddress()<<"\n";
-
-
-
-    Ptr<NodeOption> option = m_node->GetPrevNode()->GetNodeOption();
-
-    std::cout<<"node="<<m_node->GetId()<<": rec entr time: "<<Simulator::Now().GetSeconds()<<"\t"<<m_node->GetPrevNode()->entrTimeInMac<<"\n";
+  NS_LOG_LOGIC ("node=" << m_node->GetId () << ": receive traffic from " << from);
+
+  // frames of other nodes relayed on the upstream device are neither
+  // parent state nor child activity
+  bool upstream = device->ipAddr == m_node->GetNodeOption()->GetParentAddress();
+  bool fromParent = upstream && IsFromParent(device, from);
+
+  if(protocol == PccpHeader::PROT_NUMBER){
+    // strip the piggybacked state; only the parent's state is of interest
+    Ptr<Packet> packet = p->Copy();
+    PccpHeader header;
+    if(fromParent){
+      Ptr<NodeOption> parentOption = m_node->GetNodeOption()->GetParentOption();
+      if(!parentOption){
+        parentOption = CreateObject<NodeOption>();
+        m_node->GetNodeOption()->SetParentOption(parentOption);
+      }
+      header.SetNodeOption(parentOption);
+    }
+    m_signalingRxBytes += packet->RemoveHeader(header);
+    protocol = header.GetProtocol();
+
+    // the entry time in the sender is meaningless here
+    PccpTimestampTag timestampTag;
+    packet->RemovePacketTag(timestampTag);
+    p = packet;
+
+    if(fromParent){
+      m_upstreamDevice = device;
+      if(m_controlInterval.IsZero()){
+        // new parent state: new rate control epoch
+        UpdateRate(device);
+      }
+      else if(!m_controlEvent.IsRunning()){
+        // first parent state: start the periodic epochs
+        ControlEpoch();
+      }
+    }
+  }
 
-    int diff = Simulator::Now().GetMicroSeconds() - m_node->GetPrevNode()->entrTimeInMac;
-    double newTs = 0.9 * option->GetTs() + 0.1 * diff / 100.0;
-    //std::cout<<"new Ts: " << newTs<<", curTs="<<option->GetTs()<<", diff="<<diff <<"\n";
-    option->SetTs(newTs);
-    std::cout<<"node="<<m_node->GetId()<<": updating Ts="<< option->GetTs()<<"\n";
+  if(!upstream){
+    NotifyChildActivity(device, from);
 
-  /*--------------------------- my changes ends ---------------------------*/
+    // packets from children are transit traffic once forwarded upstream
+    PccpTransitTag transitTag;
+    if(!p->PeekPacketTag(transitTag)){
+      p->AddPacketTag(transitTag);
+    }
+  }
 
+  // the reference is valid as long as no handler is registered, which
+  // handlers do not do
+  const HandlerVector &handlers = GetHandlers (device, protocol);
 
-  bool found = false;
+  NS_ABORT_MSG_IF (handlers.empty (), "Handler for protocol " << p << " and device " << device <<
+                                      " not found. It isn't forwarded up; it dies here.");
 
-  for (ProtocolHandlerList::iterator i = m_handlers.begin ();
-       i != m_handlers.end (); i++)
+  for (const auto& handler : handlers)
     {
-      if (i->device == 0
-          || (i->device != 0 && i->device == device))
-        {
-          if (i->protocol == 0
-              || i->protocol == protocol)
-            {
-              NS_LOG_DEBUG ("Found handler for packet " << p << ", protocol " <<
-                            protocol << " and NetDevice " << device <<
-                            ". Send packet up");
-              i->handler (device, p, protocol, from, to, packetType);
-              found = true;
-            }
-        }
+      NS_LOG_DEBUG ("Found handler for packet " << p << ", protocol " <<
+                    protocol << " and NetDevice " << device <<
+                    ". Send packet up");
+      handler (device, p, protocol, from, to, packetType);
     }
 
-  NS_ABORT_MSG_IF (!found, "Handler for protocol " << p << " and device " << device <<
-                           " not found. It isn't forwarded up; it dies here.");
+  /*--------------------------- my changes ends ---------------------------*/
 }
 
 void
@@ -370,24 +559,21 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
 
   Ptr<NodeOption> option = m_node->GetNodeOption();
 
-  m_node->entrTimeInMac = Simulator::Now().GetMicroSeconds();
-
-  std::cout<<"node="<<m_node->GetId()<<": entr time: "<<Simulator::Now().GetSeconds()<<"\t"<<m_node->entrTimeInMac<<"\n";
+  Time curTime = Simulator::Now();
 
-  //Time after = Simulator::Now();
-  // double curTs = option->GetTs();
-  double curTa = option->GetTa();
-
-
-  //if(option->GetPktsSinceLastICD() % 2 == 1){
-    Time curTime = Simulator::Now();
-    int elapsedTime = (curTime - elapsedTimeSinceLastICD).GetMilliSeconds();
-    option->SetTa(0.9 * curTa + 0.1 * elapsedTime / 100.0);
-    option->SetPktsSinceLastICD(option->GetPktsSinceLastICD() + 1);
-    std::cout<<"node="<<m_node->GetId()<<": updating Ta="<< option->GetTa()<<"\n";
-    elapsedTimeSinceLastICD = curTime;
-  //}
+  // entry time of the packet in this node, read back in NotifyTxEnd
+  PccpTimestampTag timestampTag;
+  timestampTag.SetTime(curTime);
+  timestampTag.SetNodeId(m_node->GetId());
+  item->GetPacket()->ReplacePacketTag(timestampTag);
 
+#if NS3_PCCP_TRACING
+  double oldTa = option->GetTa();
+#endif
+  option->AddTaSample((curTime - elapsedTimeSinceLastICD).GetSeconds());
+  option->SetPktsSinceLastICD(option->GetPktsSinceLastICD() + 1);
+  PCCP_TRACE (m_traceTaUpdated, oldTa, option->GetTa());
+  elapsedTimeSinceLastICD = curTime;
 
   /*--------------------------- my changes ends ---------------------------*/
 
@@ -395,12 +581,20 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
   NS_LOG_DEBUG ("Send packet to device " << device << " protocol number " <<
                 item->GetProtocol ());
 
+  SendToDevice (device, item);
+}
+
+void
+TrafficControlLayer::SendToDevice (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << device << item);
+
   Ptr<NetDeviceQueueInterface> devQueueIface;
-  std::map<Ptr<NetDevice>, NetDeviceInfo>::iterator ndi = m_netDevices.find (device);
+  NetDeviceInfo *ndi = LookupNetDeviceInfo (device);
 
-  if (ndi != m_netDevices.end ())
+  if (ndi)
   {
-    devQueueIface = ndi->second.m_ndqi;
+    devQueueIface = ndi->m_ndqi;
   }
 
   // determine the transmission queue of the device where the packet will be enqueued
@@ -418,50 +612,7 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
 
   NS_ASSERT (!devQueueIface || txq < devQueueIface->GetNTxQueues ());
 
-
-  /*--------------------------- my changes starts ---------------------------*/
-
-  if(device->ipAddr == option->GetParentAddress()){
-    std::cout<<"node="<<m_node->GetId()<< ": Upstream traffic " << ", " << option->GetParentAddress()<< "\n";
-
-    double r_src = SrcRate();
-    std::cout<<"node="<<m_node->GetId()<< ": src rate="<< r_src << "\n";
-
-    if(r_src > 0){
-
-      Ptr<NodeOption> parentOption = m_node->GetParentNode()->GetNodeOption();
-      double degree = parentOption->GetTs() * 1.0 / parentOption->GetTa();
-
-      if(degree >= 3.0){
-        std::cout<<"node="<<m_node->GetId()<<": About to enqueue. degree="<< degree <<"\n";
-        pccpQueue.push(item);
-        return;
-      }
-
-    }
-    else{
-      std::cout<< "No congestion\n";
-    }
-
-  }
-  else{
-    std::cout<<"node="<<m_node->GetId()<< ": Not Upstream traffic: " << device->ipAddr << ", " << option->GetParentAddress() << "\n";
-  } 
-
-
-  if(!pccpQueue.empty()){
-    pccpQueue.push(item);
-    std::cout<<"node="<<m_node->GetId()<<" queue size="<<pccpQueue.size() <<"\n";
-    Ptr<QueueDiscItem> curItem = pccpQueue.front();
-    pccpQueue.pop();
-    item = curItem;
-  }
-
-
-  /*--------------------------- my changes ends ---------------------------*/
-
-
-  if (ndi == m_netDevices.end () || ndi->second.m_rootQueueDisc == 0)
+  if (!ndi || ndi->m_rootQueueDisc == 0)
     {
       // The device has no attached queue disc, thus add the header to the packet and
       // send it directly to the device if the selected queue is not stopped
@@ -474,16 +625,7 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
               SocketPriorityTag priorityTag;
               item->GetPacket ()->RemovePacketTag (priorityTag);
             }
-          device->Send (item->GetPacket (), item->GetAddress (), item->GetProtocol ());
-
-          /*--------------------------- my changes starts ---------------------------*/
-
-          // after = Simulator::Now();
-          // Time diff = after - pktServiceStart;
-          // option->SetTs(0.9 * curTs + 0.1 * diff.GetSeconds());
-          // std::cout<<"updating Ta="<< option->GetTs()<<"\n";
-
-          /*--------------------------- my changes ends ---------------------------*/
+          PccpDeviceSend (device, item);
         }
     }
   else
@@ -492,36 +634,10 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
       // selected for the packet and try to dequeue packets from such queue disc
       item->SetTxQueueIndex (txq);
 
-      Ptr<QueueDisc> qDisc = ndi->second.m_queueDiscsToWake[txq];
+      Ptr<QueueDisc> qDisc = ndi->m_queueDiscsToWake[txq];
       NS_ASSERT (qDisc);
-      bool isQueued = qDisc->Enqueue (item);
-
-      if(isQueued == false){
-        std::cout<<"Packet is dropped\n";
-      }
-      else{
-        std::cout<<"node="<<m_node->GetId()<<": Packet is enqueued\n";
-      }
-
+      qDisc->Enqueue (item);
       qDisc->Run ();
-
-      /*--------------------------- my changes starts ---------------------------*/
-
-      //if(qDisc->isTransmitted){
-        //std::cout<<"Packet is dequeued and transmitted\n";
-        //after = Simulator::Now();
-        //Time diff = after - before;
-
-
-        // double newTs = 0.9 * curTs + 0.1 * 0.01;
-        // std::cout<<"new Ts: " << newTs<<", curTs="<<curTs<<"\n";
-        // option->SetTs(newTs);
-        // std::cout<<"node="<<m_node->GetId()<<": updating Ts="<< option->GetTs()<<"\n";
-
-        //qDisc->isTransmitted = false;        
-      //}
-
-      /*--------------------------- my changes ends ---------------------------*/
     }
 }
 
@@ -532,43 +648,59 @@ TrafficControlLayer::Send (Ptr<NetDevice> device, Ptr<QueueDiscItem> item)
 // void TrafficControlLayer::InitializePRA(){
 
 // }
-double TrafficControlLayer::ScheduleRate(){
+double TrafficControlLayer::ParentDegree() const{
+  Ptr<NodeOption> parentOption = m_node->GetNodeOption()->GetParentOption();
 
-  Ptr<NodeOption> option = m_node->GetNodeOption();
-  Ptr<Node> parent = m_node->GetParentNode();
-  Ptr<NodeOption> parentOption = parent->GetNodeOption();
+  // nothing heard from the parent yet, or no Ta estimate: a Ta below half
+  // a Q12.20 step (or negative / NaN at the sender) arrives as 0, and Ta
+  // is also the divisor of the total rate in ScheduleRate
+  if(!parentOption || !(parentOption->GetTa() > 0)){
+    return -1.0;
+  }
 
-  double curTs = parentOption->GetTs();
-  double curTa = parentOption->GetTa();
+  // congestion at the parent or anywhere above it. The path degree already
+  // includes the parent's own Ts/Ta as of its last send; the max only picks
+  // up a newer local value, it does not count the parent twice.
+  return std::max(parentOption->GetTs() / parentOption->GetTa(), parentOption->GetPathDegree());
+}
 
-  double degree = curTs/ curTa;
+double TrafficControlLayer::ScheduleRate(double degree){
 
   if(degree < 1.0){
     return -1.0;
   }
-  else if(degree > 1.0){
-    std::cout<<"node="<<m_node->GetId()<< ": congestion has occured. curTs="<<curTs<<", curTa="<<curTa<<", degree = " << degree <<"\n";
-  }
 
-  double total_rate = 1.0 / curTs;
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+  Ptr<NodeOption> parentOption = option->GetParentOption();
+  double curTs = parentOption->GetTs();
+  double curTa = parentOption->GetTa();
+  NS_LOG_LOGIC ("node=" << m_node->GetId() << ": congestion has occured. curTs=" << curTs
+                << ", curTa=" << curTa << ", degree=" << degree);
+
+  // 1 / curTs when the parent is the bottleneck; with a more congested
+  // ancestor, only 1 / degree of the parent's arrival rate gets through it
+  double total_rate = 1.0 / (curTa * degree);
   double r_svc = option->GetSvc();
+  // the parent GP includes ours; 0 only for a stale mirror of a parent
+  // without traffic priority
+  double gpShare = parentOption->GetGP() > 0 ? option->GetGP() * 1.0 / parentOption->GetGP() : 0.0;
 
   if(parentOption->GetOffsprings() < option->GetParentOffsprings()){
-    std::cout<<"option 1\n";
+    NS_LOG_LOGIC ("option 1");
     r_svc = r_svc * 1.0 / degree;
   }
   else if(parentOption->GetOffsprings() > option->GetParentOffsprings()){
-    std::cout<<"option 2\n";
-    r_svc = total_rate * (option->GetGP() * 1.0 / parentOption->GetGP());
+    NS_LOG_LOGIC ("option 2");
+    r_svc = total_rate * gpShare;
   }
   else{
     if(degree <= option->GetParentDegree()){
-      std::cout<<"option 3\n";
+      NS_LOG_LOGIC ("option 3");
       r_svc = r_svc * 1.0 / degree;
     }
     else{
-      std::cout<<"option 4\n";
-      r_svc = total_rate * (option->GetGP() * 1.0 / parentOption->GetGP());
+      NS_LOG_LOGIC ("option 4");
+      r_svc = total_rate * gpShare;
     }
   }
   option->SetParentDegree(degree);  
@@ -578,13 +710,212 @@ double TrafficControlLayer::ScheduleRate(){
     r_svc = 1.0 / option->GetTs();
   }
 
-  return r_svc * 0.98;
+  return r_svc * m_safetyFactor;
+}
+
+void TrafficControlLayer::UpdateRate(Ptr<NetDevice> device){
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+  double degree = ParentDegree();
+  double r_src = SrcRate(degree);
+  Time interval = Seconds (0);
+
+  if(r_src > 0){
+    PCCP_TRACE (m_traceRateComputed, degree, r_src);
+
+    if(degree >= m_congestionThreshold){
+      NS_LOG_LOGIC ("node=" << m_node->GetId() << ": pacing upstream traffic, degree=" << degree);
+      interval = PacingInterval (r_src);
+    }
+  }
+
+  // the backlog is held and paced by the PccpQueueDisc of the upstream device
+  Ptr<PccpQueueDisc> pccpQDisc = DynamicCast<PccpQueueDisc> (GetRootQueueDiscOnDevice (device));
+  if(pccpQDisc){
+    pccpQDisc->SetPacingInterval (interval);
+    pccpQDisc->SetSourceShare (option->GetSourceShare());
+  }
 }
 
-double TrafficControlLayer::SrcRate(){
-  double r_svc = ScheduleRate();
-  std::cout<<"node="<<m_node->GetId()<<": schedule rate: " << r_svc << "\n";
-  double r_src = r_svc * (m_node->GetNodeOption()->GetSP() * 1.0 / m_node->GetNodeOption()->GetGP());
+void TrafficControlLayer::ControlEpoch(){
+  UpdateRate(m_upstreamDevice);
+  m_controlEvent = Simulator::Schedule(m_controlInterval, &TrafficControlLayer::ControlEpoch, this);
+}
+
+void TrafficControlLayer::NotifyTxEnd(Ptr<const Packet> packet){
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+  PccpTimestampTag timestampTag;
+
+  // control frames and packets not sent through this layer carry no tag;
+  // frames relayed by the MAC (e.g. by an AP) carry the tag of their sender
+  if(!option || !packet->PeekPacketTag(timestampTag) || timestampTag.GetNodeId() != m_node->GetId()){
+    return;
+  }
+
+#if NS3_PCCP_TRACING
+  double oldTs = option->GetTs();
+#endif
+  option->AddTsSample((Simulator::Now() - timestampTag.GetTime()).GetSeconds());
+  PCCP_TRACE (m_traceTsUpdated, oldTs, option->GetTs());
+}
+
+const TrafficControlLayer::HandlerVector & TrafficControlLayer::GetHandlers(Ptr<NetDevice> device, uint16_t protocol){
+  uint64_t key = (static_cast<uint64_t> (device->GetIfIndex()) << 16) | protocol;
+  auto it = m_dispatch.find(key);
+  if(it != m_dispatch.end()){
+    return it->second;
+  }
+
+  // first packet of this (device, protocol): resolve the wildcards once, in
+  // registration order
+  HandlerVector handlers;
+  for(const auto& entry : m_handlers){
+    if((entry.device == 0 || entry.device == device)
+       && (entry.protocol == 0 || entry.protocol == protocol)){
+      handlers.push_back(entry.handler);
+    }
+  }
+  return m_dispatch.emplace(key, handlers).first->second;
+}
+
+void TrafficControlLayer::IndexNetDevice(Ptr<NetDevice> device, bool indexed){
+  uint32_t index = device->GetIfIndex();
+  if(index >= m_netDevicesByIfIndex.size()){
+    m_netDevicesByIfIndex.resize(index + 1, nullptr);
+  }
+  m_netDevicesByIfIndex[index] = indexed ? &*m_netDevices.find(device) : nullptr;
+}
+
+TrafficControlLayer::NetDeviceInfo * TrafficControlLayer::LookupNetDeviceInfo(Ptr<NetDevice> device) const{
+  // map entries never move, so the pointers stay valid until the entry is
+  // erased; the device check guards against a device of another node
+  uint32_t index = device->GetIfIndex();
+  if(index < m_netDevicesByIfIndex.size() && m_netDevicesByIfIndex[index]
+     && m_netDevicesByIfIndex[index]->first == device){
+    return &m_netDevicesByIfIndex[index]->second;
+  }
+  return nullptr;
+}
+
+void TrafficControlLayer::NotifyChildActivity(Ptr<NetDevice> device, const Address &from){
+  auto it = m_children.find(from);
+  if(it == m_children.end()){
+    ChildInfo info;
+    info.node = FindChild(device, from);
+    info.active = false;
+    it = m_children.emplace(from, info).first;
+  }
+
+  ChildInfo &child = it->second;
+  if(!child.node){
+    return;
+  }
+
+  child.lastSeen = Simulator::Now();
+  if(!child.active){
+    Ptr<NodeOption> option = m_node->GetNodeOption();
+    child.active = true;
+    option->SetOffsprings(option->GetOffsprings() + 1);
+    NodeOption::SetNodeIdle(child.node, false);
+    NS_LOG_LOGIC ("node=" << m_node->GetId() << ": child " << child.node->GetId()
+                  << " active, offsprings=" << option->GetOffsprings());
+    // a single pending check per child, pushed back lazily in CheckChildIdle
+    child.idleEvent = Simulator::Schedule(m_idleTimeout, &TrafficControlLayer::CheckChildIdle, this, from);
+  }
+}
+
+void TrafficControlLayer::CheckChildIdle(Address from){
+  ChildInfo &child = m_children[from];
+  Time silence = Simulator::Now() - child.lastSeen;
+
+  if(silence < m_idleTimeout){
+    child.idleEvent = Simulator::Schedule(m_idleTimeout - silence, &TrafficControlLayer::CheckChildIdle, this, from);
+    return;
+  }
+
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+  child.active = false;
+  option->SetOffsprings(option->GetOffsprings() - 1);
+  NodeOption::SetNodeIdle(child.node, true);
+  NS_LOG_LOGIC ("node=" << m_node->GetId() << ": child " << child.node->GetId()
+                << " idle, offsprings=" << option->GetOffsprings());
+}
+
+Ptr<Node> TrafficControlLayer::FindChild(Ptr<NetDevice> device, const Address &from) const{
+  Ptr<Channel> channel = device->GetChannel();
+  if(!channel){
+    return 0;
+  }
+  for(std::size_t i = 0; i < channel->GetNDevices(); i++){
+    Ptr<NetDevice> dev = channel->GetDevice(i);
+    if(dev->GetAddress() == from){
+      Ptr<Node> node = dev->GetNode();
+      return node->GetParentNode() == m_node ? node : 0;
+    }
+  }
+  return 0;
+}
+
+bool TrafficControlLayer::IsFromParent(Ptr<NetDevice> device, const Address &from){
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+
+  if(option->GetParentMacAddress().IsInvalid()){
+    Ptr<Node> parent = m_node->GetParentNode();
+    Ptr<Channel> channel = device->GetChannel();
+    if(!parent || !channel){
+      return false;
+    }
+    for(std::size_t i = 0; i < channel->GetNDevices(); i++){
+      Ptr<NetDevice> dev = channel->GetDevice(i);
+      if(dev->GetNode() == parent){
+        NS_LOG_LOGIC ("node=" << m_node->GetId() << ": parent MAC address " << dev->GetAddress());
+        option->SetParentMacAddress(dev->GetAddress());
+        break;
+      }
+    }
+  }
+
+  return from == option->GetParentMacAddress();
+}
+
+void TrafficControlLayer::PccpDeviceSend(Ptr<NetDevice> device, Ptr<QueueDiscItem> item){
+  Ptr<NodeOption> option = m_node->GetNodeOption();
+  uint16_t protocol = item->GetProtocol();
+
+  if(option){
+    option->UpdatePathDegree();
+    PccpHeader header;
+    header.SetProtocol(protocol);
+    header.SetNodeOption(option);
+    item->GetPacket()->AddHeader(header);
+    m_signalingTxBytes += header.GetSerializedSize();
+    protocol = PccpHeader::PROT_NUMBER;
+  }
+
+  device->Send (item->GetPacket (), item->GetAddress (), protocol);
+}
+
+uint64_t TrafficControlLayer::GetSignalingTxBytes(void) const{
+  return m_signalingTxBytes;
+}
+
+uint64_t TrafficControlLayer::GetSignalingRxBytes(void) const{
+  return m_signalingRxBytes;
+}
+
+Time TrafficControlLayer::PacingInterval(double rate) const{
+  // Ts is in seconds, so rates derived from 1 / Ts are in packets per second
+  return Seconds (1.0 / rate);
+}
+
+double TrafficControlLayer::SrcRate(double degree){
+  double r_svc = ScheduleRate(degree);
+  NS_LOG_LOGIC ("node=" << m_node->GetId() << ": schedule rate: " << r_svc);
+  if(r_svc < 0){
+    // not congested: keep the last real rate, which options 1 and 3 of
+    // ScheduleRate scale at the next congested epoch
+    return r_svc;
+  }
+  double r_src = r_svc * m_node->GetNodeOption()->GetSourceShare();
   m_node->GetNodeOption()->SetSvc(r_src);
   return r_src;
 }
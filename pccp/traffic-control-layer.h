@@ -24,9 +24,42 @@
 #include "ns3/net-device.h"
 #include "ns3/node.h"
 #include "ns3/queue-item.h"
+#include "ns3/traced-callback.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/tag.h"
 #include <map>
+#include <unordered_map>
 #include <vector>
-#include <queue>
+
+/*--------------------------- my changes starts ---------------------------*/
+
+/**
+ * \ingroup traffic-control
+ * Whether the PCCP trace points are compiled in. They are compiled out of
+ * the Send/Receive path of optimized builds, and of any build configured
+ * with CXXFLAGS="-DNS3_PCCP_DISABLE_TRACING";
+ * CXXFLAGS="-DNS3_PCCP_ENABLE_TRACING" keeps them in an optimized build.
+ * Code computing values only for a trace goes in "#if NS3_PCCP_TRACING".
+ */
+#if !defined (NS3_PCCP_ENABLE_TRACING) && \
+  (defined (NS3_PCCP_DISABLE_TRACING) || defined (NS3_BUILD_PROFILE_OPTIMIZED))
+#define NS3_PCCP_TRACING 0
+#else
+#define NS3_PCCP_TRACING 1
+#endif
+
+/**
+ * \ingroup traffic-control
+ * Fire a PCCP trace source, if NS3_PCCP_TRACING.
+ */
+#if NS3_PCCP_TRACING
+#define PCCP_TRACE(trace, ...) trace (__VA_ARGS__)
+#else
+#define PCCP_TRACE(trace, ...)
+#endif
+
+/*--------------------------- my changes ends ---------------------------*/
 
 namespace ns3 {
 
@@ -34,6 +67,58 @@ class Packet;
 class QueueDisc;
 class NetDeviceQueueInterface;
 
+/*--------------------------- my changes starts ---------------------------*/
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Packet tag carrying the time a packet entered the traffic control
+ *        layer of the node transmitting it, to measure its service time.
+ *
+ * Tags survive the channel, and a Wi-Fi AP relays frames at the MAC level
+ * without passing them through its traffic control layer, so the tag also
+ * names the node that set it.
+ */
+class PccpTimestampTag : public Tag
+{
+public:
+  PccpTimestampTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \param time the time the packet entered the traffic control layer
+   */
+  void SetTime (Time time);
+  /**
+   * \return the time the packet entered the traffic control layer
+   */
+  Time GetTime (void) const;
+  /**
+   * \param nodeId the id of the node the packet entered
+   */
+  void SetNodeId (uint32_t nodeId);
+  /**
+   * \return the id of the node the packet entered
+   */
+  uint32_t GetNodeId (void) const;
+
+private:
+  Time m_time;         //!< entry time
+  uint32_t m_nodeId;   //!< node the entry time belongs to
+};
+
+/*--------------------------- my changes ends ---------------------------*/
+
 /**
  * \defgroup traffic-control
  *
@@ -200,8 +285,27 @@ public:
   /*--------------------------- my changes starts ---------------------------*/
 
   // void InitializePRA();
-  double ScheduleRate();
-  double SrcRate();
+  // degree is the congestion degree of the parent path, as returned by
+  // ParentDegree at the start of the rate control epoch
+  double ScheduleRate(double degree);
+  double SrcRate(double degree);
+
+  /**
+   * TracedCallback signature for the rate computed at a rate control epoch.
+   *
+   * \param [in] degree congestion degree of the parent node
+   * \param [in] rate the source rate of this node
+   */
+  typedef void (* RateTracedCallback)(double degree, double rate);
+
+  /**
+   * \return the bytes of PCCP state piggybacked on the packets sent so far
+   */
+  uint64_t GetSignalingTxBytes (void) const;
+  /**
+   * \return the bytes of PCCP state stripped from the packets received so far
+   */
+  uint64_t GetSignalingRxBytes (void) const;
 
   /*--------------------------- my changes ends ---------------------------*/
 
@@ -224,6 +328,84 @@ private:
    * Disable default implementation to avoid misuse
    */
   TrafficControlLayer& operator= (TrafficControlLayer const &);
+
+  /*--------------------------- my changes starts ---------------------------*/
+
+  /**
+   * \brief Hand a packet to the root queue disc of the device, or to the
+   *        device itself if no queue disc is installed
+   * \param device the device the packet must be sent to
+   * \param item a queue item including a packet and additional information
+   */
+  void SendToDevice (Ptr<NetDevice> device, Ptr<QueueDiscItem> item);
+  /**
+   * \brief Piggyback the PCCP state of this node on the packet and give it
+   *        to the device
+   * \param device the device the packet must be sent to
+   * \param item a queue item whose header has already been added
+   */
+  void PccpDeviceSend (Ptr<NetDevice> device, Ptr<QueueDiscItem> item);
+  /**
+   * \brief Start a rate control epoch: compute the parent degree and the
+   *        source rate once, and configure the pacing of the upstream
+   *        PccpQueueDisc accordingly
+   * \param device the upstream device
+   */
+  void UpdateRate (Ptr<NetDevice> device);
+  /**
+   * \return the congestion degree of the parent path: the higher of the
+   *         parent's Ts/Ta and the path degree it advertised, or -1 if
+   *         nothing was heard from the parent yet or its Ta is not positive
+   */
+  double ParentDegree (void) const;
+  /**
+   * \brief Periodic rate control epoch on the upstream device, every
+   *        ControlInterval
+   */
+  void ControlEpoch (void);
+  /**
+   * \brief Update the service time of this node when a packet it sent has
+   *        been completely transmitted by the PHY
+   * \param packet the transmitted packet
+   */
+  void NotifyTxEnd (Ptr<const Packet> packet);
+  /**
+   * \brief Record traffic received from a child; a child becoming active is
+   *        counted in the active offsprings and GP of this node
+   * \param device the receiving device
+   * \param from the MAC address of the sender
+   */
+  void NotifyChildActivity (Ptr<NetDevice> device, const Address &from);
+  /**
+   * \brief Mark a child idle if nothing was received from it for IdleTimeout
+   * \param from the MAC address of the child
+   */
+  void CheckChildIdle (Address from);
+  /**
+   * \brief Find the child of this node owning the given MAC address on the
+   *        channel of the device
+   * \param device the receiving device
+   * \param from the MAC address of the sender
+   * \return the child node, or 0 if the sender is not a child of this node
+   */
+  Ptr<Node> FindChild (Ptr<NetDevice> device, const Address &from) const;
+  /**
+   * \brief Whether a frame received on the upstream device was sent by the
+   *        parent itself, and not relayed by it (e.g. by a Wi-Fi AP) from
+   *        another node. The MAC address of the parent is looked up on the
+   *        channel of the device once and kept in the NodeOption.
+   * \param device the upstream device
+   * \param from the MAC address of the sender
+   * \return true if the sender is the parent of this node
+   */
+  bool IsFromParent (Ptr<NetDevice> device, const Address &from);
+  /**
+   * \param rate a source rate as returned by SrcRate
+   * \return the time between two departures at the given rate
+   */
+  Time PacingInterval (double rate) const;
+
+  /*--------------------------- my changes ends ---------------------------*/
   /**
    * \brief Protocol handler entry.
    * This structure is used to demultiplex all the protocols.
@@ -266,11 +448,70 @@ private:
   std::map<Ptr<NetDevice>, NetDeviceInfo> m_netDevices;
   ProtocolHandlerList m_handlers;  //!< List of upper-layer handlers
 
+  /*--------------------------- my changes starts ---------------------------*/
+
+  /**
+   * \brief Make the m_netDevices entry of the device reachable by its
+   *        interface index, or unreachable if it is being erased
+   * \param device the device
+   * \param indexed whether the entry must be reachable
+   */
+  void IndexNetDevice (Ptr<NetDevice> device, bool indexed);
+  /**
+   * \brief Per-packet lookup of the m_netDevices entry of a device
+   * \param device the device
+   * \return the entry, or 0 if there is none
+   */
+  NetDeviceInfo * LookupNetDeviceInfo (Ptr<NetDevice> device) const;
+
+  /// Handlers a packet is passed up to
+  typedef std::vector<Node::ProtocolHandler> HandlerVector;
+
+  /**
+   * \brief Handlers matching a device and protocol, wildcards included
+   * \param device the receiving device
+   * \param protocol the protocol of the packet
+   * \return the handlers, in registration order
+   */
+  const HandlerVector & GetHandlers (Ptr<NetDevice> device, uint16_t protocol);
+
+  /// Handlers by (ifIndex, protocol), filled on first use and cleared
+  /// whenever a handler is registered
+  std::unordered_map<uint64_t, HandlerVector> m_dispatch;
+
+  /// Entries of m_netDevices indexed by NetDevice::GetIfIndex, 0 if none
+  std::vector<std::map<Ptr<NetDevice>, NetDeviceInfo>::value_type *> m_netDevicesByIfIndex;
+
+  /*--------------------------- my changes ends ---------------------------*/
+
 
   /*--------------------------- my changes starts ---------------------------*/
 
+  /**
+   * \brief Activity of a child, keyed by its MAC address
+   */
+  struct ChildInfo
+  {
+    Ptr<Node> node;      //!< the child, or 0 if the sender is not a child
+    bool active;         //!< whether the child is counted as active
+    Time lastSeen;       //!< last time traffic was received from the child
+    EventId idleEvent;   //!< pending idle check
+  };
+
   Time elapsedTimeSinceLastICD;
-  std::queue<Ptr<QueueDiscItem>> pccpQueue;
+  std::map<Address, ChildInfo> m_children;   //!< children traffic was received from
+  Time m_idleTimeout;             //!< silence after which a child is idle
+  double m_congestionThreshold;   //!< parent degree from which upstream traffic is paced
+  double m_safetyFactor;          //!< fraction of the computed scheduling rate actually used
+  uint64_t m_signalingTxBytes;    //!< bytes of PccpHeader sent
+  uint64_t m_signalingRxBytes;    //!< bytes of PccpHeader received
+  Time m_controlInterval;         //!< period of the rate control epochs, 0 if per parent header
+  EventId m_controlEvent;         //!< next periodic rate control epoch
+  Ptr<NetDevice> m_upstreamDevice; //!< device the parent was last heard on
+
+  TracedCallback<double, double> m_traceTaUpdated;            //!< Ta of this node updated (old, new)
+  TracedCallback<double, double> m_traceTsUpdated;            //!< Ts of this node updated (old, new)
+  TracedCallback<double, double> m_traceRateComputed;         //!< parent degree and source rate
 
   /*--------------------------- my changes ends ---------------------------*/
 